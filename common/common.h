@@ -7,10 +7,12 @@
 #include <bit>
 #include <bitset>
 #include <cassert>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <optional>
@@ -20,8 +22,12 @@
 #include <string_view>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread>
 #include <tbb/concurrent_vector.h>
 #include <tbb/enumerable_thread_specific.h>
+#include <tbb/global_control.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #ifdef _WIN32
@@ -94,6 +100,7 @@ std::string get_self_path();
 void cleanup();
 void install_signal_handler();
 i64 get_default_thread_count();
+std::optional<i64> parse_size(std::string_view str);
 
 static u64 combine_hash(u64 a, u64 b) {
   return a ^ (b + 0x9e3779b9 + (a << 6) + (a >> 2));
@@ -162,7 +169,11 @@ private:
 template <typename Context>
 class Error {
 public:
-  Error(Context &ctx) : out(ctx, &std::cerr) {
+  Error(Context &ctx)
+    : out(ctx, ctx.suppress_diagnostics ? nullptr : &std::cerr) {
+    if (ctx.suppress_diagnostics)
+      return;
+
     if (ctx.arg.noinhibit_exec) {
       out << add_color(ctx, "warning");
     } else {
@@ -184,7 +195,11 @@ template <typename Context>
 class Warn {
 public:
   Warn(Context &ctx)
-    : out(ctx, ctx.arg.suppress_warnings ? nullptr : &std::cerr) {
+    : out(ctx, (ctx.arg.suppress_warnings || ctx.suppress_diagnostics)
+                 ? nullptr : &std::cerr) {
+    if (ctx.suppress_diagnostics)
+      return;
+
     if (ctx.arg.fatal_warnings) {
       out << add_color(ctx, "error");
       ctx.has_error = true;
@@ -400,9 +415,24 @@ inline u64 read_uleb(u8 *&buf) {
   u8 byte;
   do {
     byte = *buf++;
-    val |= (byte & 0x7f) << shift;
+    val |= (u64)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return val;
+}
+
+inline i64 read_sleb(u8 *&buf) {
+  u64 val = 0;
+  u8 shift = 0;
+  u8 byte;
+  do {
+    byte = *buf++;
+    val |= (u64)(byte & 0x7f) << shift;
     shift += 7;
   } while (byte & 0x80);
+
+  if (shift < 64 && (byte & 0x40))
+    val |= -(1ULL << shift);
   return val;
 }
 
@@ -434,6 +464,7 @@ std::string_view save_string(Context &ctx, const std::string &str) {
   memcpy(buf, str.data(), str.size());
   buf[str.size()] = '\0';
   ctx.string_pool.push_back(std::unique_ptr<u8[]>(buf));
+  ctx.string_pool_size += str.size() + 1;
   return {(char *)buf, str.size()};
 }
 
@@ -471,6 +502,10 @@ public:
     }
   }
 
+  i64 get_memory_usage() const {
+    return nbuckets * (sizeof(keys[0]) + sizeof(key_sizes[0]) + sizeof(T));
+  }
+
   void resize(i64 nbuckets) {
     this->~ConcurrentMap();
 
@@ -546,6 +581,43 @@ private:
   static constexpr const char *marker = "marker";
 };
 
+//
+// Arena allocator
+//
+
+// Objects such as input sections are created in large numbers while
+// reading input files and live until the linker exits. Allocating them
+// one by one from the general-purpose allocator is expensive, so such
+// classes override operator new to use this bump allocator instead.
+//
+// Each thread has its own current block, so objects created by the same
+// thread (e.g. sections of the same input file) are laid out contiguously
+// in memory. Memory allocated by arena_alloc() is never freed.
+u8 *arena_alloc_block(i64 size);
+
+// Returns the total size of blocks allocated by arena_alloc_block().
+i64 get_arena_size();
+
+inline void *arena_alloc(i64 size) {
+  constexpr i64 block_size = 1024 * 1024;
+  thread_local u8 *cur = nullptr;
+  thread_local u8 *end = nullptr;
+
+  size = align_to(size, alignof(std::max_align_t));
+
+  if (end - cur < size) {
+    // Large objects get their own blocks.
+    if (block_size / 4 < size)
+      return arena_alloc_block(size);
+    cur = arena_alloc_block(block_size);
+    end = cur + block_size;
+  }
+
+  void *p = cur;
+  cur += size;
+  return p;
+}
+
 //
 // output-file.h
 //
@@ -557,6 +629,7 @@ public:
   open(Context &ctx, std::string path, i64 filesize, i64 perm);
 
   virtual void close(Context &ctx) = 0;
+  virtual void resize(Context &ctx, i64 filesize) = 0;
   virtual ~OutputFile() = default;
 
   u8 *buf = nullptr;
@@ -565,6 +638,10 @@ public:
   bool is_mmapped;
   bool is_unmapped = false;
 
+  // A file descriptor for the output file if `buf` is a memory-mapped
+  // view of it. Otherwise, -1.
+  int fd = -1;
+
 protected:
   OutputFile(std::string path, i64 filesize, bool is_mmapped)
     : path(path), filesize(filesize), is_mmapped(is_mmapped) {}
@@ -668,6 +745,39 @@ std::string get_realpath(std::string_view path);
 std::string path_clean(std::string_view path);
 std::filesystem::path to_abs_path(std::filesystem::path path);
 
+//
+// dir-index.cc
+//
+
+// DirectoryIndex holds the names of files in library search directories,
+// so that we can find a library without probing every directory with
+// open(2). Directories are read in parallel. If `cache_path` is not
+// empty, listings are loaded from and saved to that file. Names in a
+// directory on a case-insensitive file system are compared
+// case-insensitively.
+class DirectoryIndex {
+public:
+  DirectoryIndex(std::span<const std::string> dirs,
+                 const std::string &cache_path);
+
+  bool may_contain(std::string_view dir, std::string_view name) const;
+
+private:
+  struct Entry {
+    std::string abs_path;
+    std::unordered_set<std::string> names;
+    i64 mtime = -1;
+    bool valid = false;
+    bool case_insensitive = false;
+  };
+
+  void read_cache(const std::string &path);
+  void write_cache(const std::string &path);
+
+  std::unordered_map<std::string, Entry> index;
+  std::unordered_map<std::string, Entry> cache;
+};
+
 //
 // demangle.cc
 //
@@ -679,6 +789,13 @@ std::optional<std::string_view> cpp_demangle(std::string_view name);
 // compress.cc
 //
 
+// A function to read the i'th shard of input data for compressors. It
+// returns the shard contents, which may be stored to a given scratch
+// buffer. With this, compressors can compress data that doesn't exist
+// in memory as a whole.
+typedef std::function<std::string_view(i64 idx, std::vector<u8> &scratch)>
+  ShardReader;
+
 class Compressor {
 public:
   virtual void write_to(u8 *buf) = 0;
@@ -689,6 +806,7 @@ public:
 class ZlibCompressor : public Compressor {
 public:
   ZlibCompressor(u8 *buf, i64 size);
+  ZlibCompressor(i64 num_shards, ShardReader read);
   void write_to(u8 *buf) override;
 
 private:
@@ -699,10 +817,109 @@ private:
 class ZstdCompressor : public Compressor {
 public:
   ZstdCompressor(u8 *buf, i64 size);
+  ZstdCompressor(i64 num_shards, ShardReader read);
   void write_to(u8 *buf) override;
 
 private:
   std::vector<std::vector<u8>> shards;
+  std::vector<i64> sizes;
+};
+
+// Decompress zlib or zstd-compressed data to a given buffer. `size` is
+// the expected uncompressed size. If the data consists of independently
+// compressed pieces, they are decompressed in parallel. zstd frames are
+// decompressed directly into `out`, while zlib segments go through
+// temporary buffers. Returns false if the data is corrupted.
+bool zlib_decompress(std::string_view in, u8 *out, i64 size);
+bool zstd_decompress(std::string_view in, u8 *out, i64 size);
+
+//
+// jobserver.cc
+//
+
+// JobServer is a client of the GNU make jobserver. If mold is invoked
+// by `make -jN`, it uses as many threads as the number of tokens it can
+// acquire from make plus one. create() returns nullptr if the jobserver
+// is not available.
+class JobServer {
+public:
+  static std::unique_ptr<JobServer> create(i64 max_threads);
+  ~JobServer();
+
+  void grow();
+  void release();
+  i64 num_threads() const { return num_tokens + 1; }
+
+  static void release_on_exit();
+
+private:
+  JobServer() = default;
+
+  // Tokens are kept in a fixed-size array so that release_on_exit()
+  // can be called from a signal handler.
+  static constexpr i64 MAX_TOKENS = 1024;
+
+  std::mutex mu;
+  std::unique_ptr<tbb::global_control> control;
+  char tokens[MAX_TOKENS];
+  std::atomic<i64> num_tokens = 0;
+  i64 max_threads = 0;
+  int rfd = -1;
+  int wfd = -1;
+};
+
+//
+// numa.cc
+//
+
+// NumaScheduler runs tasks on the CPUs of a given NUMA node. It has a
+// task arena for each node, and threads are pinned to the node's CPUs
+// while they are in the arena. Since the kernel allocates a page on the
+// node that first touches it, pages faulted in by such tasks are local
+// to the node.
+//
+// NumaScheduler is available only on Linux hosts with two or more NUMA
+// nodes. create() returns nullptr otherwise.
+class NumaScheduler {
+public:
+  static std::unique_ptr<NumaScheduler> create(i64 num_threads);
+  ~NumaScheduler();
+
+  i64 num_nodes() const { return nodes.size(); }
+  void run(i64 node, std::function<void()> fn);
+  void wait();
+
+private:
+  struct Node;
+  NumaScheduler() = default;
+  std::vector<std::unique_ptr<Node>> nodes;
+};
+
+//
+// prefetch.cc
+//
+
+// Prefetcher starts reading given files into the page cache in the
+// background. Only the symbol tables of archives are read. Archive
+// members that turn out to be needed can be added later with add().
+// The destructor stops it if it is still running. Available only on
+// systems that support posix_fadvise.
+class Prefetcher {
+public:
+  Prefetcher(std::vector<std::string> paths);
+  ~Prefetcher();
+
+  // Reads a given range of an mmap'ed file ahead.
+  void add(u8 *data, i64 size);
+
+private:
+  void run(std::vector<std::string> paths);
+
+  std::mutex mu;
+  std::condition_variable cond;
+  std::vector<std::span<u8>> ranges;
+  std::atomic_bool stopped = false;
+  std::thread thread;
 };
 
 //
@@ -743,6 +960,24 @@ private:
   static inline std::vector<Counter *> instances;
 };
 
+// Hardware performance counters for --perf-counters. They are opened
+// with perf_event_open(2) and count events of the calling thread and
+// of all threads created after open_hw_counters() is called. They are
+// available only on Linux.
+enum {
+  HW_CYCLES,
+  HW_INSTRUCTIONS,
+  HW_LLC_MISSES,
+  HW_DTLB_MISSES,
+  HW_BRANCH_MISSES,
+  NUM_HW_COUNTERS,
+};
+
+bool open_hw_counters();
+bool hw_counters_enabled();
+std::array<i64, NUM_HW_COUNTERS> read_hw_counters();
+void add_hw_counter_stats();
+
 // Timer and TimeRecord records elapsed time (wall clock time)
 // used by each pass of the linker.
 struct TimerRecord {
@@ -756,12 +991,41 @@ struct TimerRecord {
   i64 end;
   i64 user;
   i64 sys;
+  i64 minflt;
+  i64 majflt;
+  i64 peak_rss;
+  i64 peak_rss_delta = 0;
+  i64 rss;
+  i64 rss_delta = 0;
+  i64 tid;
+  std::array<i64, NUM_HW_COUNTERS> hw = {};
   bool stopped = false;
 };
 
 void
 print_timer_records(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &);
 
+void
+print_timer_records_json(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &,
+                         std::ostream &out);
+
+void
+print_timer_records_trace(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &,
+                          std::ostream &out);
+
+// For --stats. Prints how much each pass changed the resident set size
+// and in which pass the peak RSS was reached.
+void
+print_memory_stats(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &);
+
+// For --stats. Adds counters for the malloc heap size if available.
+void add_malloc_stats();
+
+// Returns the current and the peak resident set size of this process
+// in bytes, or 0 if it is not available on the host.
+i64 get_rss();
+i64 get_peak_rss();
+
 template <typename Context>
 class Timer {
 public:
@@ -814,6 +1078,14 @@ private:
 // Memory-mapped file
 //
 
+inline i64 get_mtime_nsec(const struct stat &st) {
+#ifdef __linux__
+  return (i64)st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec;
+#else
+  return (i64)st.st_mtime * 1'000'000'000;
+#endif
+}
+
 // MappedFile represents an mmap'ed input file.
 // mold uses mmap-IO only.
 template <typename Context>
@@ -859,6 +1131,12 @@ public:
   MappedFile *parent = nullptr;
   MappedFile *thin_parent = nullptr;
   int fd = -1;
+
+  // The identity of the file at the time it was mapped, used to check
+  // whether it has been replaced or modified since then.
+  u64 dev = 0;
+  u64 ino = 0;
+  i64 mtime_nsec = 0;
 #ifdef _WIN32
   HANDLE file_handle = INVALID_HANDLE_VALUE;
 #endif
@@ -888,6 +1166,9 @@ MappedFile<Context> *MappedFile<Context>::open(Context &ctx, std::string path) {
 
   mf->name = path;
   mf->size = st.st_size;
+  mf->dev = st.st_dev;
+  mf->ino = st.st_ino;
+  mf->mtime_nsec = get_mtime_nsec(st);
 
   if (st.st_size > 0) {
 #ifdef _WIN32
@@ -7,7 +7,19 @@
 // and concatenate them. We then append a header, a trailer and a
 // checksum so that the concatenated data is valid zlib-format data.
 //
-// zstd-compressed data can be merged in the same way.
+// zstd-compressed data can be merged in the same way. We also append a
+// seek table in the zstd seekable format so that consumers can find
+// frame boundaries without scanning the frames.
+//
+// Input data doesn't have to exist in memory as a whole. A caller can
+// give us a function to produce each shard on demand, so that only
+// shards that are being compressed are materialized at any moment.
+//
+// We decompress input data in parallel if it consists of independently
+// compressed pieces like the ones we create. For zstd, each frame
+// records its size, so it's easy to find frame boundaries. zlib doesn't
+// have such metadata, so we guess boundaries by looking for flush
+// markers and verify the guess using the checksum.
 //
 // Using threads to compress data has a downside. Since the dictionary
 // is reset on boundaries of shards, compression ratio is sacrificed
@@ -30,18 +42,6 @@ namespace mold {
 
 static constexpr i64 SHARD_SIZE = 1024 * 1024;
 
-static std::vector<std::string_view> split(std::string_view input) {
-  std::vector<std::string_view> shards;
-
-  while (input.size() >= SHARD_SIZE) {
-    shards.push_back(input.substr(0, SHARD_SIZE));
-    input = input.substr(SHARD_SIZE);
-  }
-  if (!input.empty())
-    shards.push_back(input);
-  return shards;
-}
-
 static std::vector<u8> zlib_compress(std::string_view input) {
   // Initialize zlib stream. Since debug info is generally compressed
   // pretty well with lower compression levels, we chose compression
@@ -97,22 +97,33 @@ static std::vector<u8> zlib_compress(std::string_view input) {
   return buf;
 }
 
-ZlibCompressor::ZlibCompressor(u8 *buf, i64 size) {
-  std::string_view input{(char *)buf, (size_t)size};
-  std::vector<std::string_view> inputs = split(input);
-  std::vector<u64> adlers(inputs.size());
-  shards.resize(inputs.size());
+ZlibCompressor::ZlibCompressor(u8 *buf, i64 size)
+  : ZlibCompressor(align_to(size, SHARD_SIZE) / SHARD_SIZE,
+                   [=](i64 i, std::vector<u8> &) {
+    i64 begin = i * SHARD_SIZE;
+    return std::string_view((char *)buf + begin,
+                            std::min(SHARD_SIZE, size - begin));
+  }) {}
 
-  // Compress each shard
-  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
-    adlers[i] = adler32(1, (u8 *)inputs[i].data(), inputs[i].size());
-    shards[i] = zlib_compress(inputs[i]);
+ZlibCompressor::ZlibCompressor(i64 num_shards, ShardReader read) {
+  std::vector<u64> adlers(num_shards);
+  std::vector<u64> sizes(num_shards);
+  shards.resize(num_shards);
+
+  // Compress each shard. Uncompressed data is alive only while
+  // its shard is being compressed.
+  tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
+    std::vector<u8> scratch;
+    std::string_view input = read(i, scratch);
+    adlers[i] = adler32(1, (u8 *)input.data(), input.size());
+    sizes[i] = input.size();
+    shards[i] = zlib_compress(input);
   });
 
   // Combine checksums
-  checksum = adlers[0];
-  for (i64 i = 1; i < inputs.size(); i++)
-    checksum = adler32_combine(checksum, adlers[i], inputs[i].size());
+  checksum = 1;
+  for (i64 i = 0; i < num_shards; i++)
+    checksum = adler32_combine(checksum, adlers[i], sizes[i]);
 
   // Comput the total size
   compressed_size = 8; // the header and the trailer
@@ -156,30 +167,294 @@ static std::vector<u8> zstd_compress(std::string_view input) {
   return buf;
 }
 
-ZstdCompressor::ZstdCompressor(u8 *buf, i64 size) {
-  std::string_view input{(char *)buf, (size_t)size};
-  std::vector<std::string_view> inputs = split(input);
-  shards.resize(inputs.size());
+ZstdCompressor::ZstdCompressor(u8 *buf, i64 size)
+  : ZstdCompressor(align_to(size, SHARD_SIZE) / SHARD_SIZE,
+                   [=](i64 i, std::vector<u8> &) {
+    i64 begin = i * SHARD_SIZE;
+    return std::string_view((char *)buf + begin,
+                            std::min(SHARD_SIZE, size - begin));
+  }) {}
+
+// The zstd seekable format appends a skippable frame containing
+// compressed and uncompressed sizes of each frame to a zstd stream.
+static constexpr u32 ZSTD_SEEKTABLE_MAGIC = 0x184D2A5E;
+static constexpr u32 ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1;
+static constexpr i64 ZSTD_SEEKTABLE_FOOTER_SIZE = 9;
+
+static i64 get_seektable_size(i64 num_frames) {
+  return 8 + num_frames * 8 + ZSTD_SEEKTABLE_FOOTER_SIZE;
+}
+
+ZstdCompressor::ZstdCompressor(i64 num_shards, ShardReader read) {
+  shards.resize(num_shards);
+  sizes.resize(num_shards);
 
   // Compress each shard
-  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
-    shards[i] = zstd_compress(inputs[i]);
+  tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
+    std::vector<u8> scratch;
+    std::string_view input = read(i, scratch);
+    sizes[i] = input.size();
+    shards[i] = zstd_compress(input);
   });
 
   compressed_size = 0;
   for (std::vector<u8> &shard : shards)
     compressed_size += shard.size();
+
+  // A seek table is useful only if there are two or more frames
+  if (num_shards > 1)
+    compressed_size += get_seektable_size(num_shards);
 }
 
 void ZstdCompressor::write_to(u8 *buf) {
   // Copy compressed data
-  std::vector<i64> offsets(shards.size());
-  for (i64 i = 1; i < shards.size(); i++)
+  std::vector<i64> offsets(shards.size() + 1);
+  for (i64 i = 1; i <= shards.size(); i++)
     offsets[i] = offsets[i - 1] + shards[i - 1].size();
 
   tbb::parallel_for((i64)0, (i64)shards.size(), [&](i64 i) {
     memcpy(&buf[offsets[i]], shards[i].data(), shards[i].size());
   });
+
+  if (shards.size() <= 1)
+    return;
+
+  // Write a seek table
+  ul32 *p = (ul32 *)(buf + offsets.back());
+  *p++ = ZSTD_SEEKTABLE_MAGIC;
+  *p++ = get_seektable_size(shards.size()) - 8;
+
+  for (i64 i = 0; i < shards.size(); i++) {
+    *p++ = shards[i].size();
+    *p++ = sizes[i];
+  }
+
+  *p++ = shards.size();
+  u8 *q = (u8 *)p;
+  *q++ = 0; // Seek_Table_Descriptor; no checksums
+  *(ul32 *)q = ZSTD_SEEKABLE_MAGIC;
+}
+
+static constexpr i64 ZLIB_SEGMENT_SIZE = 1024 * 1024;
+
+// Inflate a raw deflate segment that doesn't refer to any data before
+// the segment. If `is_last` is false, the segment must end at a block
+// boundary.
+static bool inflate_segment(std::string_view in, bool is_last,
+                            std::vector<u8> &out) {
+  z_stream strm = {};
+  if (inflateInit2(&strm, -15) != Z_OK)
+    return false;
+
+  out.resize(std::max<i64>(in.size() * 4, 4096));
+  strm.next_in = (u8 *)in.data();
+  strm.avail_in = in.size();
+  strm.next_out = out.data();
+  strm.avail_out = out.size();
+
+  bool ok = false;
+
+  for (;;) {
+    if (strm.avail_out == 0) {
+      i64 len = strm.total_out;
+      out.resize(out.size() * 2);
+      strm.next_out = out.data() + len;
+      strm.avail_out = out.size() - len;
+    }
+
+    // Z_BLOCK makes inflate() return at each block boundary, so that
+    // we can check whether the segment ends at a block boundary.
+    int r = inflate(&strm, Z_BLOCK);
+
+    if (r == Z_STREAM_END) {
+      ok = is_last && strm.avail_in == 0;
+      break;
+    }
+
+    if (r != Z_OK && r != Z_BUF_ERROR)
+      break;
+
+    if (strm.avail_in == 0) {
+      // The last block may still have buffered bits to decode.
+      if (is_last && r == Z_OK)
+        continue;
+
+      bool at_boundary = (strm.data_type & 128) && (strm.data_type & 7) == 0;
+      ok = !is_last && at_boundary && r == Z_OK;
+      break;
+    }
+  }
+
+  out.resize(strm.total_out);
+  inflateEnd(&strm);
+  return ok;
+}
+
+// Data compressed by ZlibCompressor consists of independently-compressed
+// segments each of which ends with a Z_SYNC_FLUSH or Z_FULL_FLUSH marker
+// (00 00 ff ff). We split the input after such markers and decompress
+// each segment in parallel. Since the marker may appear by chance, the
+// result is verified with the checksum, and we fall back to the regular
+// single-threaded decompression if verification fails.
+//
+// Unlike zstd frames, zlib segments don't record their uncompressed
+// sizes, so we don't know where each segment's output begins until all
+// preceding segments have been inflated. Therefore, segments are
+// inflated into temporary buffers first and then copied to `out`.
+static bool zlib_decompress_parallel(std::string_view in, u8 *out, i64 size) {
+  // Check the zlib header. FDICT must not be set.
+  if (in.size() < 6 || (in[0] & 0x0f) != 8 || (in[1] & 0x20) ||
+      ((u8)in[0] * 256 + (u8)in[1]) % 31)
+    return false;
+
+  std::string_view body = in.substr(2, in.size() - 6);
+  constexpr std::string_view marker("\0\0\xff\xff", 4);
+
+  std::vector<i64> splits = {0};
+  for (;;) {
+    i64 pos = body.find(marker, splits.back() + ZLIB_SEGMENT_SIZE);
+    if (pos == body.npos || pos + 4 == body.size())
+      break;
+    splits.push_back(pos + 4);
+  }
+  splits.push_back(body.size());
+
+  i64 num_segments = splits.size() - 1;
+  if (num_segments == 1)
+    return false;
+
+  std::vector<std::vector<u8>> bufs(num_segments);
+  std::atomic_bool ok = true;
+
+  tbb::parallel_for((i64)0, num_segments, [&](i64 i) {
+    std::string_view seg = body.substr(splits[i], splits[i + 1] - splits[i]);
+    if (!inflate_segment(seg, i == num_segments - 1, bufs[i]))
+      ok = false;
+  });
+
+  if (!ok)
+    return false;
+
+  std::vector<i64> offsets(num_segments + 1);
+  for (i64 i = 0; i < num_segments; i++)
+    offsets[i + 1] = offsets[i] + bufs[i].size();
+  if (offsets.back() != size)
+    return false;
+
+  std::vector<u64> adlers(num_segments);
+  tbb::parallel_for((i64)0, num_segments, [&](i64 i) {
+    memcpy(out + offsets[i], bufs[i].data(), bufs[i].size());
+    adlers[i] = adler32(1, bufs[i].data(), bufs[i].size());
+  });
+
+  u64 checksum = 1;
+  for (i64 i = 0; i < num_segments; i++)
+    checksum = adler32_combine(checksum, adlers[i], bufs[i].size());
+  return checksum == *(ub32 *)(in.data() + in.size() - 4);
+}
+
+bool zlib_decompress(std::string_view in, u8 *out, i64 size) {
+  if (in.size() >= ZLIB_SEGMENT_SIZE * 2 &&
+      zlib_decompress_parallel(in, out, size))
+    return true;
+
+  unsigned long size2 = size;
+  return ::uncompress(out, &size2, (u8 *)in.data(), in.size()) == Z_OK &&
+         size2 == size;
+}
+
+struct ZstdFrame {
+  i64 in_offset;
+  i64 in_size;
+  i64 out_offset;
+  i64 out_size;
+};
+
+// Read frame boundaries from a seek table if exists.
+static std::vector<ZstdFrame> read_zstd_seektable(std::string_view in) {
+  if (in.size() < ZSTD_SEEKTABLE_FOOTER_SIZE + 8 ||
+      *(ul32 *)(in.data() + in.size() - 4) != ZSTD_SEEKABLE_MAGIC)
+    return {};
+
+  i64 num_frames = *(ul32 *)(in.data() + in.size() - 9);
+  u8 desc = in[in.size() - 5];
+  if (desc != 0 || in.size() < get_seektable_size(num_frames))
+    return {};
+
+  u8 *p = (u8 *)in.data() + in.size() - get_seektable_size(num_frames);
+  if (*(ul32 *)p != ZSTD_SEEKTABLE_MAGIC ||
+      *(ul32 *)(p + 4) != get_seektable_size(num_frames) - 8)
+    return {};
+
+  std::vector<ZstdFrame> frames;
+  i64 in_offset = 0;
+  i64 out_offset = 0;
+
+  ul32 *entries = (ul32 *)(p + 8);
+
+  for (i64 i = 0; i < num_frames; i++) {
+    i64 in_size = entries[i * 2];
+    i64 out_size = entries[i * 2 + 1];
+    frames.push_back({in_offset, in_size, out_offset, out_size});
+    in_offset += in_size;
+    out_offset += out_size;
+  }
+
+  if (in_offset != p - (u8 *)in.data())
+    return {};
+  return frames;
+}
+
+// Find frame boundaries by reading frame headers.
+static std::vector<ZstdFrame> scan_zstd_frames(std::string_view in) {
+  std::vector<ZstdFrame> frames;
+  i64 in_offset = 0;
+  i64 out_offset = 0;
+
+  while (in_offset < in.size()) {
+    const char *p = in.data() + in_offset;
+    size_t rest = in.size() - in_offset;
+
+    size_t in_size = ZSTD_findFrameCompressedSize(p, rest);
+    if (ZSTD_isError(in_size))
+      return {};
+
+    // Skip skippable frames
+    if (rest >= 4 && (*(ul32 *)p & 0xFFFF'FFF0) == ZSTD_MAGIC_SKIPPABLE_START) {
+      in_offset += in_size;
+      continue;
+    }
+
+    unsigned long long out_size = ZSTD_getFrameContentSize(p, rest);
+    if (out_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+        out_size == ZSTD_CONTENTSIZE_ERROR)
+      return {};
+
+    frames.push_back({in_offset, (i64)in_size, out_offset, (i64)out_size});
+    in_offset += in_size;
+    out_offset += out_size;
+  }
+  return frames;
+}
+
+bool zstd_decompress(std::string_view in, u8 *out, i64 size) {
+  std::vector<ZstdFrame> frames = read_zstd_seektable(in);
+  if (frames.empty())
+    frames = scan_zstd_frames(in);
+
+  if (frames.size() <= 1 ||
+      frames.back().out_offset + frames.back().out_size != size)
+    return ZSTD_decompress(out, size, in.data(), in.size()) == size;
+
+  std::atomic_bool ok = true;
+
+  tbb::parallel_for_each(frames, [&](ZstdFrame &f) {
+    size_t sz = ZSTD_decompress(out + f.out_offset, f.out_size,
+                                in.data() + f.in_offset, f.in_size);
+    if (sz != f.out_size)
+      ok = false;
+  });
+  return ok;
 }
 
 } // namespace mold
@@ -0,0 +1,220 @@
+// This file implements an index of library search directories.
+//
+// Finding a library for `-lfoo` requires probing `libfoo.so` and
+// `libfoo.a` in each `-L` directory in order. With dozens of search
+// directories and hundreds of libraries, most of these probes are
+// failed open(2) calls, which are slow on network file systems.
+//
+// Instead, we read each search directory once up front and answer
+// lookups from memory. Only a lookup for a file that does exist
+// touches the file system.
+//
+// Optionally, directory listings can be saved to a cache file. A
+// cached listing is used if the directory's mtime hasn't changed,
+// because creating, removing or renaming a file in a directory
+// updates the directory's mtime.
+
+#include "common.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <tbb/parallel_for.h>
+
+#ifdef _WIN32
+# include <process.h>
+#endif
+
+namespace mold {
+
+static constexpr std::string_view CACHE_MAGIC = "mold-dir-index-v1";
+
+static i64 get_mtime(const std::filesystem::path &dir) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(dir, ec);
+  if (ec)
+    return -1;
+  return time.time_since_epoch().count();
+}
+
+static std::string to_lower(std::string s) {
+  for (char &c : s)
+    c = std::tolower((u8)c);
+  return s;
+}
+
+// Returns true if file names in a given directory are case-insensitive,
+// as is the default on macOS and Windows. Then `-lFoo` finds libfoo.a.
+static bool is_case_insensitive(const std::string &dir,
+                                const std::unordered_set<std::string> &names) {
+#if defined(_WIN32)
+  return true;
+#elif defined(_PC_CASE_SENSITIVE)
+  return pathconf(dir.c_str(), _PC_CASE_SENSITIVE) == 0;
+#else
+  // Flip the case of a file name and see if the file can still be found.
+  for (const std::string &name : names) {
+    std::string flipped = name;
+    for (char &c : flipped)
+      c = std::isupper((u8)c) ? std::tolower((u8)c) : std::toupper((u8)c);
+
+    if (flipped == name)
+      continue;
+    if (names.contains(flipped))
+      return false;
+
+    std::error_code ec;
+    return std::filesystem::exists(dir + "/" + flipped, ec);
+  }
+  return false;
+#endif
+}
+
+DirectoryIndex::DirectoryIndex(std::span<const std::string> dirs,
+                               const std::string &cache_path) {
+  std::vector<Entry> ents(dirs.size());
+  for (i64 i = 0; i < dirs.size(); i++)
+    ents[i].abs_path = to_abs_path(dirs[i]).string();
+
+  if (!cache_path.empty())
+    read_cache(cache_path);
+
+  std::atomic_bool updated = false;
+
+  tbb::parallel_for((i64)0, (i64)dirs.size(), [&](i64 i) {
+    Entry &ent = ents[i];
+    ent.mtime = get_mtime(ent.abs_path);
+    if (ent.mtime == -1)
+      return;
+
+    if (auto it = cache.find(ent.abs_path);
+        it != cache.end() && it->second.mtime == ent.mtime) {
+      ent.names = it->second.names;
+    } else {
+      std::error_code ec;
+      std::filesystem::directory_iterator iter(ent.abs_path, ec);
+      if (ec)
+        return;
+
+      for (auto end = std::filesystem::end(iter); iter != end;
+           iter.increment(ec)) {
+        if (ec)
+          return;
+        ent.names.insert(iter->path().filename().string());
+      }
+      updated = true;
+    }
+
+    ent.valid = true;
+    ent.case_insensitive = is_case_insensitive(ent.abs_path, ent.names);
+  });
+
+  for (i64 i = 0; i < dirs.size(); i++) {
+    Entry &ent = ents[i];
+    if (!ent.valid)
+      continue;
+
+    cache[ent.abs_path] = ent;
+
+    if (ent.case_insensitive) {
+      std::unordered_set<std::string> names;
+      for (const std::string &name : ent.names)
+        names.insert(to_lower(name));
+      ent.names = std::move(names);
+    }
+    index.insert({dirs[i], std::move(ent)});
+  }
+
+  if (!cache_path.empty() && updated)
+    write_cache(cache_path);
+  cache.clear();
+}
+
+// Returns false if `dir/name` definitely does not exist. If `name`
+// contains a slash, only its first path component is looked up.
+// Returns true if the answer is not known, e.g. if `dir` wasn't
+// indexed.
+bool DirectoryIndex::may_contain(std::string_view dir,
+                                 std::string_view name) const {
+  auto it = index.find(std::string(dir));
+  if (it == index.end())
+    return true;
+  name = name.substr(0, name.find('/'));
+  if (name.empty() || name == "." || name == "..")
+    return true;
+
+  if (it->second.case_insensitive)
+    return it->second.names.contains(to_lower(std::string(name)));
+  return it->second.names.contains(std::string(name));
+}
+
+// The cache file is a text file. Each directory is represented by a
+// line containing its mtime, the number of entries and its absolute
+// path, followed by one line for each entry.
+void DirectoryIndex::read_cache(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  if (!std::getline(in, line) || line != CACHE_MAGIC)
+    return;
+
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    Entry ent;
+    i64 num_names;
+    if (!(ss >> ent.mtime >> num_names) || ss.get() != ' ')
+      return;
+    std::getline(ss, ent.abs_path);
+
+    for (i64 i = 0; i < num_names; i++) {
+      if (!std::getline(in, line))
+        return;
+      ent.names.insert(line);
+    }
+    cache[ent.abs_path] = std::move(ent);
+  }
+}
+
+// Writes the cache to a temporary file and then renames it, so that
+// concurrent links sharing the same cache file never see a partially-
+// written file. Failing to write the cache is not an error.
+void DirectoryIndex::write_cache(const std::string &path) {
+  std::string tmp = path + ".tmp" + std::to_string(getpid());
+  std::ofstream out(tmp);
+  if (!out)
+    return;
+
+  auto has_newline = [](std::string_view s) {
+    return s.find('\n') != s.npos;
+  };
+
+  // A directory modified within the resolution of its mtime might
+  // be modified again without changing its mtime. Don't cache such
+  // a directory.
+  i64 now = std::filesystem::file_time_type::clock::now().time_since_epoch().count();
+  i64 margin = std::chrono::duration_cast<std::filesystem::file_time_type::duration>(
+    std::chrono::seconds(2)).count();
+
+  out << CACHE_MAGIC << "\n";
+
+  for (auto &[abs_path, ent] : cache) {
+    if (has_newline(abs_path) || now - ent.mtime < margin ||
+        std::any_of(ent.names.begin(), ent.names.end(), has_newline))
+      continue;
+
+    out << ent.mtime << " " << ent.names.size() << " " << abs_path << "\n";
+    for (const std::string &name : ent.names)
+      out << name << "\n";
+  }
+
+  out.close();
+
+  std::error_code ec;
+  if (out)
+    std::filesystem::rename(tmp, path, ec);
+  if (!out || ec)
+    std::filesystem::remove(tmp, ec);
+}
+
+} // namespace mold
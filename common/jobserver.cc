@@ -0,0 +1,165 @@
+// This file implements a client of the GNU make jobserver.
+//
+// If make is invoked with `-jN`, it creates a pipe (or a named FIFO
+// since GNU make 4.4) containing N-1 tokens and passes it to child
+// processes via MAKEFLAGS as `--jobserver-auth=R,W` or
+// `--jobserver-auth=fifo:PATH`. Each child process implicitly owns one
+// token. To run one more job in parallel, a child reads a token from
+// the pipe, and it writes the token back when done.
+//
+// mold acquires tokens to decide how many threads it may use. Without
+// it, `make -j64` running eight links at once on a 64-core machine
+// would have each link start 32 threads.
+
+#include "common.h"
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sched.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace mold {
+
+static JobServer *instance;
+
+#ifdef _WIN32
+
+std::unique_ptr<JobServer> JobServer::create(i64 max_threads) {
+  return nullptr;
+}
+
+JobServer::~JobServer() {}
+void JobServer::grow() {}
+void JobServer::release() {}
+void JobServer::release_on_exit() {}
+
+#else
+
+// Returns the value of the jobserver option in MAKEFLAGS. GNU make
+// 4.2 or later uses --jobserver-auth, and older ones --jobserver-fds.
+static std::string get_auth(std::string_view flags) {
+  for (std::string_view opt : {"--jobserver-auth=", "--jobserver-fds="}) {
+    size_t pos = flags.rfind(opt);
+    if (pos != flags.npos) {
+      std::string_view val = flags.substr(pos + opt.size());
+      return std::string(val.substr(0, val.find(' ')));
+    }
+  }
+  return "";
+}
+
+static bool is_fifo(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+std::unique_ptr<JobServer> JobServer::create(i64 max_threads) {
+  char *env = getenv("MAKEFLAGS");
+  if (!env || max_threads <= 1)
+    return nullptr;
+
+  std::string auth = get_auth(env);
+  if (auth.empty())
+    return nullptr;
+
+  int rfd = -1;
+  int wfd = -1;
+
+  if (auth.starts_with("fifo:")) {
+    rfd = open(auth.c_str() + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (rfd == -1)
+      return nullptr;
+    wfd = rfd;
+  } else {
+    int r, w;
+    if (sscanf(auth.c_str(), "%d,%d", &r, &w) != 2)
+      return nullptr;
+
+    // make closes the pipe if a recipe is not marked as recursive with
+    // `+`. In that case, the file descriptors may be reused for other
+    // files, so we have to make sure that they still refer to a pipe.
+    if (!is_fifo(r) || !is_fifo(w))
+      return nullptr;
+
+    // We don't want to block on reading a token. We can't set
+    // O_NONBLOCK to the inherited file descriptor because it would
+    // affect make and all other jobs sharing the same file description.
+    // Instead, we reopen the pipe to create a new file description.
+    std::string path = "/proc/self/fd/" + std::to_string(r);
+    rfd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (rfd == -1)
+      return nullptr;
+    wfd = w;
+  }
+
+  JobServer *js = new JobServer;
+  js->rfd = rfd;
+  js->wfd = wfd;
+  js->max_threads = std::min<i64>(max_threads, MAX_TOKENS + 1);
+  instance = js;
+  return std::unique_ptr<JobServer>(js);
+}
+
+JobServer::~JobServer() {
+  release();
+  control.reset();
+  instance = nullptr;
+  close(rfd);
+}
+
+// Acquires as many tokens as available up to `max_threads - 1` without
+// blocking, and allows TBB to use that many threads plus one.
+//
+// This is called at the beginning of each major phase. Tokens held for
+// the previous phase are returned first, so that other jobs waiting
+// for a slot get a chance to take them instead of us keeping all of
+// them until the end of the link.
+void JobServer::grow() {
+  std::scoped_lock lock(mu);
+
+  if (i64 n = num_tokens.exchange(0)) {
+    (void)!write(wfd, tokens, n);
+    sched_yield();
+  }
+
+  for (i64 n = num_tokens; n < max_threads - 1; n++) {
+    if (read(rfd, tokens + n, 1) != 1)
+      break;
+    num_tokens = n + 1;
+  }
+
+  control.reset();
+  control.reset(new tbb::global_control(
+    tbb::global_control::max_allowed_parallelism, num_tokens + 1));
+}
+
+// Returns all tokens to the jobserver and limits TBB to one thread.
+void JobServer::release() {
+  std::scoped_lock lock(mu);
+
+  // A token has to be returned as the same byte as we read because
+  // make uses different bytes to distinguish token types.
+  if (i64 n = num_tokens.exchange(0))
+    (void)!write(wfd, tokens, n);
+
+  control.reset();
+  control.reset(new tbb::global_control(
+    tbb::global_control::max_allowed_parallelism, 1));
+}
+
+// Called on abnormal exit. If we didn't return tokens, make would
+// lose them and run fewer jobs for the rest of the build. This
+// function is async-signal-safe. A token being read by grow() at the
+// moment a signal arrives is not counted yet and therefore lost, but
+// that window is only a few instructions long.
+void JobServer::release_on_exit() {
+  if (JobServer *js = instance)
+    if (i64 n = js->num_tokens.exchange(0))
+      (void)!write(js->wfd, js->tokens, n);
+}
+
+#endif
+
+} // namespace mold
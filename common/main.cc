@@ -37,6 +37,7 @@ static std::string get_mold_version() {
 void cleanup() {
   if (output_tmpfile)
     unlink(output_tmpfile);
+  JobServer::release_on_exit();
 }
 
 std::string errno_string() {
@@ -141,6 +142,52 @@ i64 get_default_thread_count() {
   return std::min(n, 32);
 }
 
+static std::atomic<i64> arena_size;
+
+// Blocks are kept reachable from a global list so that leak checkers
+// don't report objects allocated by arena_alloc().
+u8 *arena_alloc_block(i64 size) {
+  static std::mutex mu;
+  static std::vector<u8 *> *blocks = new std::vector<u8 *>;
+
+  arena_size += size;
+
+  u8 *buf = (u8 *)malloc(size);
+  if (!buf) {
+    std::cerr << "mold: out of memory\n";
+    _exit(1);
+  }
+
+  std::scoped_lock lock(mu);
+  blocks->push_back(buf);
+  return buf;
+}
+
+i64 get_arena_size() {
+  return arena_size;
+}
+
+// Parses a size string such as "4096", "512M" or "16G". Suffixes are
+// binary multipliers (K = 1024). Returns nullopt if malformed.
+std::optional<i64> parse_size(std::string_view str) {
+  i64 shift = 0;
+  if (!str.empty()) {
+    switch (toupper(str.back())) {
+    case 'K': shift = 10; break;
+    case 'M': shift = 20; break;
+    case 'G': shift = 30; break;
+    case 'T': shift = 40; break;
+    }
+    if (shift)
+      str.remove_suffix(1);
+  }
+
+  if (str.empty() || str.size() > 15 ||
+      !std::all_of(str.begin(), str.end(), isdigit))
+    return {};
+  return std::stoll(std::string(str)) << shift;
+}
+
 } // namespace mold
 
 int main(int argc, char **argv) {
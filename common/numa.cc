@@ -0,0 +1,135 @@
+#include "common.h"
+
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/task_scheduler_observer.h>
+
+#ifdef __linux__
+# include <fstream>
+# include <sched.h>
+#endif
+
+namespace mold {
+
+#ifdef __linux__
+static std::string read_line(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// Parses a CPU or node list in the sysfs format such as "0-3,8-11".
+static std::vector<int> parse_cpu_list(std::string_view str) {
+  std::vector<int> vec;
+
+  while (!str.empty()) {
+    size_t pos = str.find(',');
+    std::string_view tok = str.substr(0, pos);
+    str = (pos == str.npos) ? "" : str.substr(pos + 1);
+
+    size_t dash = tok.find('-');
+    int lo = std::stoi(std::string(tok.substr(0, dash)));
+    int hi = (dash == tok.npos) ? lo : std::stoi(std::string(tok.substr(dash + 1)));
+    for (int i = lo; i <= hi; i++)
+      vec.push_back(i);
+  }
+  return vec;
+}
+
+// Pins threads to the CPUs of a NUMA node while they are in a given
+// arena, and restores the original affinity when they leave.
+class PinningObserver : public tbb::task_scheduler_observer {
+public:
+  PinningObserver(tbb::task_arena &arena, const cpu_set_t &cpus,
+                  const cpu_set_t &orig)
+    : tbb::task_scheduler_observer(arena), cpus(cpus), orig(orig) {
+    observe(true);
+  }
+
+  ~PinningObserver() {
+    observe(false);
+  }
+
+  void on_scheduler_entry(bool) override {
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+  }
+
+  void on_scheduler_exit(bool) override {
+    sched_setaffinity(0, sizeof(orig), &orig);
+  }
+
+private:
+  cpu_set_t cpus;
+  cpu_set_t orig;
+};
+#endif
+
+struct NumaScheduler::Node {
+  tbb::task_arena arena;
+  tbb::task_group tg;
+#ifdef __linux__
+  std::unique_ptr<PinningObserver> observer;
+#endif
+};
+
+NumaScheduler::~NumaScheduler() {
+  wait();
+}
+
+std::unique_ptr<NumaScheduler> NumaScheduler::create(i64 num_threads) {
+#ifdef __linux__
+  cpu_set_t orig;
+  if (sched_getaffinity(0, sizeof(orig), &orig))
+    return nullptr;
+
+  std::vector<cpu_set_t> sets;
+  std::string dir = "/sys/devices/system/node/";
+
+  for (int node : parse_cpu_list(read_line(dir + "online"))) {
+    std::string path = dir + "node" + std::to_string(node) + "/cpulist";
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (int cpu : parse_cpu_list(read_line(path)))
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &orig))
+        CPU_SET(cpu, &set);
+
+    // Memory-only nodes or nodes we are not allowed to run on are
+    // ignored.
+    if (CPU_COUNT(&set))
+      sets.push_back(set);
+  }
+
+  if (sets.size() < 2)
+    return nullptr;
+
+  // Distribute threads to nodes in proportion to their CPU counts.
+  // Each arena reserves one slot for the thread that waits for it.
+  i64 total = CPU_COUNT(&orig);
+  std::unique_ptr<NumaScheduler> sched(new NumaScheduler);
+
+  for (cpu_set_t &set : sets) {
+    i64 n = std::max<i64>(2, num_threads * CPU_COUNT(&set) / total);
+    std::unique_ptr<Node> node(new Node);
+    node->arena.initialize(n);
+    node->observer.reset(new PinningObserver(node->arena, set, orig));
+    sched->nodes.push_back(std::move(node));
+  }
+  return sched;
+#else
+  return nullptr;
+#endif
+}
+
+void NumaScheduler::run(i64 node, std::function<void()> fn) {
+  Node &n = *nodes[node % nodes.size()];
+  n.arena.execute([&] { n.tg.run(std::move(fn)); });
+}
+
+void NumaScheduler::wait() {
+  for (std::unique_ptr<Node> &n : nodes)
+    n->arena.execute([&] { n->tg.wait(); });
+}
+
+} // namespace mold
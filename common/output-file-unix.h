@@ -52,20 +52,21 @@ class MemoryMappedOutputFile : public OutputFile<Context> {
 public:
   MemoryMappedOutputFile(Context &ctx, std::string path, i64 filesize, i64 perm)
     : OutputFile<Context>(path, filesize, true) {
-    i64 fd;
-    std::tie(fd, output_tmpfile) = open_or_create_file(ctx, path, filesize, perm);
+    std::tie(this->fd, output_tmpfile) =
+      open_or_create_file(ctx, path, filesize, perm);
 
     this->buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
-                           MAP_SHARED, fd, 0);
+                           MAP_SHARED, this->fd, 0);
     if (this->buf == MAP_FAILED)
       Fatal(ctx) << path << ": mmap failed: " << errno_string();
-    ::close(fd);
 
     mold::output_buffer_start = this->buf;
     mold::output_buffer_end = this->buf + filesize;
   }
 
   ~MemoryMappedOutputFile() {
+    if (this->fd != -1)
+      ::close(this->fd);
     if (fd2 != -1)
       ::close(fd2);
   }
@@ -76,6 +77,9 @@ public:
     if (!this->is_unmapped)
       munmap(this->buf, this->filesize);
 
+    ::close(this->fd);
+    this->fd = -1;
+
     // If an output file already exists, open a file and then remove it.
     // This is the fastest way to unlink a file, as it does not make the
     // system to immediately release disk blocks occupied by the file.
@@ -88,6 +92,24 @@ public:
     output_tmpfile = nullptr;
   }
 
+  // Grow or shrink the output file. Existing contents are preserved,
+  // but `buf` may be moved to a different address.
+  void resize(Context &ctx, i64 filesize) override {
+    if (ftruncate(this->fd, filesize))
+      Fatal(ctx) << "ftruncate failed: " << errno_string();
+
+    u8 *buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, this->fd, 0);
+    if (buf == MAP_FAILED)
+      Fatal(ctx) << this->path << ": mmap failed: " << errno_string();
+    munmap(this->buf, this->filesize);
+
+    this->buf = buf;
+    this->filesize = filesize;
+    mold::output_buffer_start = buf;
+    mold::output_buffer_end = buf + filesize;
+  }
+
 private:
   int fd2 = -1;
 };
@@ -121,6 +143,18 @@ public:
     fclose(fp);
   }
 
+  void resize(Context &ctx, i64 filesize) override {
+    u8 *buf = (u8 *)mmap(NULL, filesize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+      Fatal(ctx) << "mmap failed: " << errno_string();
+
+    memcpy(buf, this->buf, std::min(filesize, this->filesize));
+    munmap(this->buf, this->filesize);
+    this->buf = buf;
+    this->filesize = filesize;
+  }
+
 private:
   i64 perm;
 };
@@ -35,6 +35,14 @@ public:
     free(this->buf);
   }
 
+  void resize(Context &ctx, i64 filesize) override {
+    u8 *buf = (u8 *)realloc(this->buf, filesize);
+    if (!buf)
+      Fatal(ctx) << "realloc failed";
+    this->buf = buf;
+    this->filesize = filesize;
+  }
+
 private:
   i64 perm;
 };
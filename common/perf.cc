@@ -9,6 +9,15 @@
 #include <sys/time.h>
 #endif
 
+#ifdef USE_MIMALLOC
+#include <mimalloc.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
 namespace mold {
 
 i64 Counter::get_value() {
@@ -35,7 +44,15 @@ static i64 now_nsec() {
 #endif
 }
 
-static std::pair<i64, i64> get_usage() {
+struct Usage {
+  i64 user = 0;
+  i64 sys = 0;
+  i64 minflt = 0;
+  i64 majflt = 0;
+  i64 maxrss = 0;
+};
+
+static Usage get_usage() {
 #ifdef _WIN32
   auto to_nsec = [](FILETIME t) -> i64 {
     return ((u64)t.dwHighDateTime << 32 + (u64)t.dwLowDateTime) * 100;
@@ -51,14 +68,147 @@ static std::pair<i64, i64> get_usage() {
 
   struct rusage ru;
   getrusage(RUSAGE_SELF, &ru);
-  return {to_nsec(ru.ru_utime), to_nsec(ru.ru_stime)};
+
+# ifdef __APPLE__
+  i64 maxrss = ru.ru_maxrss;
+# else
+  i64 maxrss = (i64)ru.ru_maxrss * 1024;
+# endif
+
+  return {to_nsec(ru.ru_utime), to_nsec(ru.ru_stime), ru.ru_minflt,
+          ru.ru_majflt, maxrss};
+#endif
+}
+
+// Returns a small integer that identifies the calling thread.
+static i64 get_thread_id() {
+  static std::atomic<i64> counter;
+  thread_local i64 id = counter++;
+  return id;
+}
+
+i64 get_rss() {
+#ifdef __linux__
+  // The second field of /proc/self/statm is the number of resident pages.
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (!fp)
+    return 0;
+
+  long size, resident;
+  int n = fscanf(fp, "%ld %ld", &size, &resident);
+  fclose(fp);
+  if (n != 2)
+    return 0;
+  return (i64)resident * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
 #endif
 }
 
+i64 get_peak_rss() {
+  return get_usage().maxrss;
+}
+
+static int hw_fds[NUM_HW_COUNTERS] = {-1, -1, -1, -1, -1};
+static bool hw_enabled = false;
+
+static const char *hw_counter_names[] = {
+  "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses",
+};
+
+bool open_hw_counters() {
+#ifdef __linux__
+  auto open = [](u32 type, u64 config) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                        PERF_FLAG_FD_CLOEXEC);
+  };
+
+  // If the cycle counter is not available, we assume that the host
+  // doesn't allow us to use the PMU at all. Other counters may be
+  // individually unavailable, in which case they read as zero.
+  hw_fds[HW_CYCLES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  if (hw_fds[HW_CYCLES] == -1)
+    return false;
+
+  hw_fds[HW_INSTRUCTIONS] =
+    open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  hw_fds[HW_LLC_MISSES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  hw_fds[HW_DTLB_MISSES] =
+    open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  hw_fds[HW_BRANCH_MISSES] =
+    open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+  hw_enabled = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool hw_counters_enabled() {
+  return hw_enabled;
+}
+
+std::array<i64, NUM_HW_COUNTERS> read_hw_counters() {
+  std::array<i64, NUM_HW_COUNTERS> vals = {};
+
+#ifdef __linux__
+  if (!hw_enabled)
+    return vals;
+
+  for (i64 i = 0; i < NUM_HW_COUNTERS; i++) {
+    // The value, the time enabled and the time running
+    u64 buf[3];
+    if (hw_fds[i] == -1 || read(hw_fds[i], buf, sizeof(buf)) != sizeof(buf))
+      continue;
+
+    // If there are more counters than the PMU has, the kernel
+    // multiplexes them. Scale the value to estimate the real count.
+    if (buf[2] && buf[2] < buf[1])
+      vals[i] = (double)buf[0] * buf[1] / buf[2];
+    else
+      vals[i] = buf[0];
+  }
+#endif
+
+  return vals;
+}
+
+void add_hw_counter_stats() {
+  if (!hw_enabled)
+    return;
+
+  std::array<i64, NUM_HW_COUNTERS> vals = read_hw_counters();
+  static Counter cycles("hw_cycles", vals[HW_CYCLES]);
+  static Counter instructions("hw_instructions", vals[HW_INSTRUCTIONS]);
+  static Counter llc_misses("hw_llc_misses", vals[HW_LLC_MISSES]);
+  static Counter dtlb_misses("hw_dtlb_misses", vals[HW_DTLB_MISSES]);
+  static Counter branch_misses("hw_branch_misses", vals[HW_BRANCH_MISSES]);
+}
+
 TimerRecord::TimerRecord(std::string name, TimerRecord *parent)
-  : name(name), parent(parent) {
+  : name(name), parent(parent), tid(get_thread_id()) {
   start = now_nsec();
-  std::tie(user, sys) = get_usage();
+  Usage u = get_usage();
+  user = u.user;
+  sys = u.sys;
+  minflt = u.minflt;
+  majflt = u.majflt;
+  peak_rss = u.maxrss;
+  rss = get_rss();
+  if (hw_enabled)
+    hw = read_hw_counters();
   if (parent)
     parent->children.push_back(this);
 }
@@ -68,22 +218,45 @@ void TimerRecord::stop() {
     return;
   stopped = true;
 
-  i64 user2;
-  i64 sys2;
-  std::tie(user2, sys2) = get_usage();
-
+  Usage u = get_usage();
   end = now_nsec();
-  user = user2 - user;
-  sys = sys2 - sys;
+  user = u.user - user;
+  sys = u.sys - sys;
+  minflt = u.minflt - minflt;
+  majflt = u.majflt - majflt;
+  peak_rss_delta = u.maxrss - peak_rss;
+  peak_rss = u.maxrss;
+
+  i64 rss2 = get_rss();
+  rss_delta = rss2 - rss;
+  rss = rss2;
+
+  if (hw_enabled) {
+    std::array<i64, NUM_HW_COUNTERS> vals = read_hw_counters();
+    for (i64 i = 0; i < NUM_HW_COUNTERS; i++)
+      hw[i] = vals[i] - hw[i];
+  }
 }
 
 static void print_rec(TimerRecord &rec, i64 indent) {
-  printf(" % 8.3f % 8.3f % 8.3f  %s%s\n",
+  printf(" % 8.3f % 8.3f % 8.3f",
          ((double)rec.user / 1'000'000'000),
          ((double)rec.sys / 1'000'000'000),
-         (((double)rec.end - rec.start) / 1'000'000'000),
-         std::string(indent * 2, ' ').c_str(),
-         rec.name.c_str());
+         (((double)rec.end - rec.start) / 1'000'000'000));
+
+  // With --perf-counters, print billions of cycles, instructions per
+  // cycle and misses per thousand instructions.
+  if (hw_enabled) {
+    double insns = std::max<i64>(rec.hw[HW_INSTRUCTIONS], 1);
+    printf(" % 8.3f % 6.2f % 8.2f % 8.2f % 8.2f",
+           (double)rec.hw[HW_CYCLES] / 1'000'000'000,
+           rec.hw[HW_INSTRUCTIONS] / std::max<double>(rec.hw[HW_CYCLES], 1),
+           rec.hw[HW_LLC_MISSES] * 1000 / insns,
+           rec.hw[HW_DTLB_MISSES] * 1000 / insns,
+           rec.hw[HW_BRANCH_MISSES] * 1000 / insns);
+  }
+
+  printf("  %s%s\n", std::string(indent * 2, ' ').c_str(), rec.name.c_str());
 
   sort(rec.children, [](TimerRecord *a, TimerRecord *b) {
     return a->start < b->start;
@@ -93,7 +266,9 @@ static void print_rec(TimerRecord &rec, i64 indent) {
     print_rec(*child, indent + 1);
 }
 
-void print_timer_records(
+// Stops all timers and infers parent-child relationships between records
+// that were created without an explicit parent.
+static void link_records(
     tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
   for (i64 i = records.size() - 1; i >= 0; i--)
     records[i]->stop();
@@ -112,8 +287,17 @@ void print_timer_records(
       }
     }
   }
+}
+
+void print_timer_records(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
+  link_records(records);
 
-  std::cout << "     User   System     Real  Name\n";
+  if (hw_enabled)
+    std::cout << "     User   System     Real   Cycles    IPC   LLC/Ki"
+              << "  DTLB/Ki    BR/Ki  Name\n";
+  else
+    std::cout << "     User   System     Real  Name\n";
 
   for (std::unique_ptr<TimerRecord> &rec : records)
     if (!rec->parent)
@@ -122,4 +306,204 @@ void print_timer_records(
   std::cout << std::flush;
 }
 
+static std::string json_string(std::string_view str) {
+  std::string buf = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      buf += '\\';
+      buf += c;
+    } else if ((u8)c < 0x20) {
+      char tmp[7];
+      snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+      buf += tmp;
+    } else {
+      buf += c;
+    }
+  }
+  return buf + "\"";
+}
+
+// Formats a non-negative nanosecond count in the given unit (1000 for
+// microseconds or 1'000'000'000 for seconds) with all its digits.
+// Printing a double via ostream would round it to six significant
+// digits, e.g. 1.23457e+07.
+static std::string format_time(i64 nsec, i64 unit) {
+  int digits = 0;
+  for (i64 i = unit; i > 1; i /= 10)
+    digits++;
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%lld.%0*lld", (long long)(nsec / unit),
+           digits, (long long)(nsec % unit));
+  return buf;
+}
+
+static void print_hw_json(TimerRecord &rec, std::ostream &out) {
+  if (hw_enabled)
+    for (i64 i = 0; i < NUM_HW_COUNTERS; i++)
+      out << ", \"" << hw_counter_names[i] << "\": " << rec.hw[i];
+}
+
+static void print_json_rec(TimerRecord &rec, i64 origin, std::ostream &out,
+                           i64 indent) {
+  std::string pad(indent * 2, ' ');
+
+  out << pad << "{\"name\": " << json_string(rec.name)
+      << ", \"start\": " << format_time(rec.start - origin, 1'000'000'000)
+      << ", \"real\": " << format_time(rec.end - rec.start, 1'000'000'000)
+      << ", \"user\": " << format_time(rec.user, 1'000'000'000)
+      << ", \"sys\": " << format_time(rec.sys, 1'000'000'000)
+      << ", \"minflt\": " << rec.minflt
+      << ", \"majflt\": " << rec.majflt
+      << ", \"peak_rss\": " << rec.peak_rss
+      << ", \"rss\": " << rec.rss
+      << ", \"rss_delta\": " << rec.rss_delta
+      << ", \"thread\": " << rec.tid;
+  print_hw_json(rec, out);
+  out << ", \"children\": [";
+
+  sort(rec.children, [](TimerRecord *a, TimerRecord *b) {
+    return a->start < b->start;
+  });
+
+  for (i64 i = 0; i < rec.children.size(); i++) {
+    out << (i ? ",\n" : "\n");
+    print_json_rec(*rec.children[i], origin, out, indent + 1);
+  }
+
+  if (!rec.children.empty())
+    out << "\n" << pad;
+  out << "]}";
+}
+
+// Prints timer records as a JSON array of trees. Times are in seconds,
+// and `start` is relative to the first record.
+void print_timer_records_json(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records,
+    std::ostream &out) {
+  link_records(records);
+
+  i64 origin = records.empty() ? 0 : records[0]->start;
+  bool first = true;
+
+  out << "[";
+  for (std::unique_ptr<TimerRecord> &rec : records) {
+    if (!rec->parent) {
+      out << (first ? "\n" : ",\n");
+      print_json_rec(*rec, origin, out, 1);
+      first = false;
+    }
+  }
+  out << "\n]\n" << std::flush;
+}
+
+// Prints timer records in the Trace Event Format, which can be loaded
+// into chrome://tracing or Perfetto. Each record becomes a complete
+// event on the track of the thread that created it.
+void print_timer_records_trace(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records,
+    std::ostream &out) {
+  link_records(records);
+
+  i64 origin = records.empty() ? 0 : records[0]->start;
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (i64 i = 0; i < records.size(); i++) {
+    TimerRecord &rec = *records[i];
+    out << (i ? ",\n" : "\n")
+        << "{\"name\": " << json_string(rec.name)
+        << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << rec.tid
+        << ", \"ts\": " << format_time(rec.start - origin, 1000)
+        << ", \"dur\": " << format_time(rec.end - rec.start, 1000)
+        << ", \"args\": {\"user\": " << format_time(rec.user, 1'000'000'000)
+        << ", \"sys\": " << format_time(rec.sys, 1'000'000'000)
+        << ", \"minflt\": " << rec.minflt
+        << ", \"majflt\": " << rec.majflt
+        << ", \"peak_rss\": " << rec.peak_rss
+        << ", \"rss\": " << rec.rss
+        << ", \"rss_delta\": " << rec.rss_delta;
+    print_hw_json(rec, out);
+    out << "}}";
+  }
+  out << "\n]}\n" << std::flush;
+}
+
+static void print_memory_rec(TimerRecord &rec, i64 indent) {
+  // Skip passes that didn't change the memory usage significantly
+  // to keep the output short.
+  constexpr i64 threshold = 1024 * 1024;
+  if (std::abs(rec.rss_delta) < threshold && rec.peak_rss_delta < threshold)
+    return;
+
+  std::cout << std::setw(20) << std::right << "mem_by_pass" << "="
+            << std::string(indent * 2, ' ') << rec.name
+            << " rss=" << rec.rss
+            << " rss_delta=" << rec.rss_delta
+            << " peak_rss_delta=" << rec.peak_rss_delta << "\n";
+
+  for (TimerRecord *child : rec.children)
+    print_memory_rec(*child, indent + 1);
+}
+
+void print_memory_stats(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
+  link_records(records);
+
+  for (std::unique_ptr<TimerRecord> &rec : records)
+    if (!rec->parent)
+      print_memory_rec(*rec, 0);
+
+  // getrusage() only tells us the peak RSS so far, so we don't know
+  // exactly when the peak occurred. We sample it at the start and the
+  // end of each pass, so the peak occurred between the last sample
+  // below the final peak and the first sample that reached it. We
+  // attribute the peak to the innermost pass covering that interval.
+  std::vector<std::pair<i64, i64>> samples;
+  i64 max = 0;
+  for (std::unique_ptr<TimerRecord> &rec : records) {
+    samples.push_back({rec->start, rec->peak_rss - rec->peak_rss_delta});
+    samples.push_back({rec->end, rec->peak_rss});
+    max = std::max(max, rec->peak_rss);
+  }
+  sort(samples);
+
+  i64 lo = INT64_MIN;
+  i64 hi = INT64_MAX;
+  for (std::pair<i64, i64> &s : samples) {
+    if (s.second < max) {
+      lo = s.first;
+    } else {
+      hi = s.first;
+      break;
+    }
+  }
+
+  // If the peak had been reached before any pass started, use the
+  // pass in which it was first observed.
+  if (lo == INT64_MIN)
+    lo = hi;
+
+  TimerRecord *peak = nullptr;
+  for (std::unique_ptr<TimerRecord> &rec : records)
+    if (rec->start <= lo && hi <= rec->end &&
+        (!peak || rec->end - rec->start < peak->end - peak->start))
+      peak = rec.get();
+
+  if (peak)
+    std::cout << std::setw(20) << std::right << "peak_rss_pass" << "="
+              << peak->name << "\n";
+  std::cout << std::flush;
+}
+
+void add_malloc_stats() {
+#ifdef USE_MIMALLOC
+  size_t elapsed, user, sys, rss, peak_rss, commit, peak_commit, faults;
+  mi_process_info(&elapsed, &user, &sys, &rss, &peak_rss, &commit,
+                  &peak_commit, &faults);
+
+  static Counter c1("malloc_committed_bytes", commit);
+  static Counter c2("malloc_peak_committed_bytes", peak_commit);
+#endif
+}
+
 } // namespace mold
@@ -0,0 +1,130 @@
+// This file implements read-ahead of input files.
+//
+// Input files are mmap'ed, and their pages are read from disk on demand
+// as parse tasks touch them. If the page cache is cold, e.g. on a CI
+// runner with a fresh checkout, each task stalls on page faults, and
+// the disk sees only a few small reads at a time.
+//
+// Prefetcher walks the list of input files in a background thread and
+// asks the kernel to start reading them into the page cache, so that
+// by the time we map a file, its pages are already being read.
+//
+// Only the headers and symbol tables of archives are read ahead, since
+// most members of a large archive are usually not needed. Once symbols
+// are resolved, the linker passes the extracted members to add(), and
+// they are read ahead before we copy their contents to the output.
+//
+// Requests are issued in bounded chunks, so that the destructor doesn't
+// have to wait for the kernel to queue reads for an entire large file.
+
+#include "common.h"
+
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+namespace mold {
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__)
+
+// Returns the size of an archive's header and symbol table, or 0 if a
+// given file is not an archive.
+static i64 get_archive_symtab_size(int fd) {
+  char buf[68];
+  if (pread(fd, buf, sizeof(buf), 0) != sizeof(buf))
+    return 0;
+
+  std::string_view magic(buf, 8);
+  if (magic != "!<arch>\n" && magic != "!<thin>\n")
+    return 0;
+
+  // The first member of an archive is the symbol table if its name is
+  // "/" or "/SYM64/". Its size is a decimal number at offset 48.
+  std::string_view name(buf + 8, 16);
+  if (!name.starts_with("/ ") && !name.starts_with("/SYM64/"))
+    return sizeof(buf);
+  return sizeof(buf) + atol(std::string(buf + 56, 10).c_str());
+}
+
+// The maximum number of bytes requested at once
+static constexpr i64 CHUNK_SIZE = 4 * 1024 * 1024;
+
+void Prefetcher::run(std::vector<std::string> paths) {
+  for (const std::string &path : paths) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      continue;
+
+    i64 size = get_archive_symtab_size(fd);
+    if (size == 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0)
+        size = st.st_size;
+    }
+
+    for (i64 i = 0; i < size && !stopped; i += CHUNK_SIZE)
+      posix_fadvise(fd, i, std::min(size - i, CHUNK_SIZE), POSIX_FADV_WILLNEED);
+    close(fd);
+
+    if (stopped)
+      return;
+  }
+
+  i64 page_size = sysconf(_SC_PAGESIZE);
+
+  for (;;) {
+    std::vector<std::span<u8>> vec;
+    {
+      std::unique_lock lock(mu);
+      cond.wait(lock, [&] { return stopped || !ranges.empty(); });
+      if (stopped)
+        return;
+      vec = std::move(ranges);
+      ranges.clear();
+    }
+
+    for (std::span<u8> range : vec) {
+      u8 *begin = (u8 *)align_down((u64)range.data(), page_size);
+      u8 *end = range.data() + range.size();
+
+      for (u8 *p = begin; p < end; p += CHUNK_SIZE) {
+        if (stopped)
+          return;
+        madvise(p, std::min<i64>(end - p, CHUNK_SIZE), MADV_WILLNEED);
+      }
+    }
+  }
+}
+
+Prefetcher::Prefetcher(std::vector<std::string> paths) {
+  thread = std::thread([this, paths = std::move(paths)]() mutable {
+    run(std::move(paths));
+  });
+}
+
+Prefetcher::~Prefetcher() {
+  {
+    std::scoped_lock lock(mu);
+    stopped = true;
+  }
+  cond.notify_one();
+  thread.join();
+}
+
+void Prefetcher::add(u8 *data, i64 size) {
+  {
+    std::scoped_lock lock(mu);
+    ranges.push_back({data, (size_t)size});
+  }
+  cond.notify_one();
+}
+
+#else
+
+Prefetcher::Prefetcher(std::vector<std::string> paths) {}
+Prefetcher::~Prefetcher() {}
+void Prefetcher::add(u8 *data, i64 size) {}
+
+#endif
+
+} // namespace mold
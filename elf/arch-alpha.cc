@@ -83,7 +83,7 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
 
   ElfRel<E> *dynrel = nullptr;
   if (ctx.reldyn)
-    dynrel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+    dynrel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                            file.reldyn_offset + this->reldyn_offset);
 
   for (i64 i = 0; i < rels.size(); i++) {
@@ -308,13 +308,17 @@ void AlphaGotSection::finalize() {
 }
 
 void AlphaGotSection::copy_buf(Context<E> &ctx) {
-  ElfRel<E> *dynrel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+void AlphaGotSection::write_to(Context<E> &ctx, u8 *loc) {
+  ElfRel<E> *dynrel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                                     reldyn_offset);
 
   for (i64 i = 0; i < entries.size(); i++) {
     Entry &e = entries[i];
     u64 P = this->shdr.sh_addr + sizeof(Word<E>) * i;
-    ul64 *buf = (ul64 *)(ctx.buf + this->shdr.sh_offset + sizeof(Word<E>) * i);
+    ul64 *buf = (ul64 *)(loc + sizeof(Word<E>) * i);
 
     if (e.sym->is_imported) {
       *buf = ctx.arg.apply_dynamic_relocs ? e.addend : 0;
@@ -243,7 +243,7 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
 
   ElfRel<E> *dynrel = nullptr;
   if (ctx.reldyn)
-    dynrel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+    dynrel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                            file.reldyn_offset + this->reldyn_offset);
 
   std::span<std::unique_ptr<RangeExtensionThunk<E>>> thunks =
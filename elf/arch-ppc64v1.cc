@@ -156,7 +156,7 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
 
   ElfRel<E> *dynrel = nullptr;
   if (ctx.reldyn)
-    dynrel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+    dynrel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                            file.reldyn_offset + this->reldyn_offset);
 
   for (i64 i = 0; i < rels.size(); i++) {
@@ -659,11 +659,15 @@ i64 PPC64OpdSection::get_reldyn_size(Context<E> &ctx) const {
 }
 
 void PPC64OpdSection::copy_buf(Context<E> &ctx) {
-  ub64 *buf = (ub64 *)(ctx.buf + this->shdr.sh_offset);
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+void PPC64OpdSection::write_to(Context<E> &ctx, u8 *loc) {
+  ub64 *buf = (ub64 *)loc;
 
   ElfRel<E> *rel = nullptr;
   if (ctx.arg.pic)
-    rel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset + reldyn_offset);
+    rel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) + reldyn_offset);
 
   for (Symbol<E> *sym : symbols) {
     u64 addr = sym->get_addr(ctx, NO_PLT | NO_OPD);
@@ -326,20 +326,45 @@ static void relax_ld_to_le(u8 *loc, ElfRel<E> rel, u64 val) {
 // Apply relocations to SHF_ALLOC sections (i.e. sections that are
 // mapped to memory at runtime) based on the result of
 // scan_relocations().
+//
+// scan_relocations() has grouped the relocations by kind. We apply the
+// two most common kinds, PC32/PLT32 and R_X86_64_64, in dedicated loops
+// and the others with a generic switch.
 template <>
 void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
   std::span<const ElfRel<E>> rels = get_rels(ctx);
+  std::span<const u32> order = extra.reloc_order;
 
   ElfRel<E> *dynrel = nullptr;
   if (ctx.reldyn)
-    dynrel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+    dynrel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                            file.reldyn_offset + this->reldyn_offset);
 
-  for (i64 i = 0; i < rels.size(); i++) {
-    const ElfRel<E> &rel = rels[i];
-    if (rel.r_type == R_NONE)
-      continue;
+  u64 addr = get_addr();
+  u64 GOTPLT = ctx.gotplt->shdr.sh_addr;
+
+  for (u32 idx : order.subspan(0, extra.pc32_end)) {
+    const ElfRel<E> &rel = rels[idx];
+    Symbol<E> &sym = *file.symbols[rel.r_sym];
+    i64 val = sym.get_addr(ctx) + rel.r_addend - (addr + rel.r_offset);
 
+    if (val != (i32)val)
+      Error(ctx) << *this << ": relocation " << rel << " against "
+                 << sym << " out of range: " << val << " is not in ["
+                 << -(1LL << 31) << ", " << (1LL << 31) << ")";
+    *(ul32 *)(base + rel.r_offset) = val;
+  }
+
+  i64 num_abs64 = extra.abs64_end - extra.pc32_end;
+  for (u32 idx : order.subspan(extra.pc32_end, num_abs64)) {
+    const ElfRel<E> &rel = rels[idx];
+    Symbol<E> &sym = *file.symbols[rel.r_sym];
+    apply_dyn_absrel(ctx, sym, rel, base + rel.r_offset, sym.get_addr(ctx),
+                     rel.r_addend, addr + rel.r_offset, dynrel);
+  }
+
+  for (u32 idx : order.subspan(extra.abs64_end)) {
+    const ElfRel<E> &rel = rels[idx];
     Symbol<E> &sym = *file.symbols[rel.r_sym];
     u8 *loc = base + rel.r_offset;
 
@@ -360,11 +385,13 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
       *(ul32 *)loc = val;
     };
 
+    // GOT addresses are looked up only by GOT-referencing relocations
+    // so that we don't touch symbol aux data for other relocations.
+    auto G = [&] { return sym.get_got_addr(ctx) - GOTPLT; };
+
     u64 S = sym.get_addr(ctx);
     u64 A = rel.r_addend;
-    u64 P = get_addr() + rel.r_offset;
-    u64 G = sym.get_got_addr(ctx) - ctx.gotplt->shdr.sh_addr;
-    u64 GOTPLT = ctx.gotplt->shdr.sh_addr;
+    u64 P = addr + rel.r_offset;
 
     switch (rel.r_type) {
     case R_X86_64_8:
@@ -381,9 +408,6 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
     case R_X86_64_32S:
       write32s(S + A);
       break;
-    case R_X86_64_64:
-      apply_dyn_absrel(ctx, sym, rel, loc, S, A, P, dynrel);
-      break;
     case R_X86_64_PC8:
       check(S + A - P, -(1 << 7), 1 << 7);
       *loc = S + A - P;
@@ -392,18 +416,14 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
       check(S + A - P, -(1 << 15), 1 << 15);
       *(ul16 *)loc = S + A - P;
       break;
-    case R_X86_64_PC32:
-    case R_X86_64_PLT32:
-      write32s(S + A - P);
-      break;
     case R_X86_64_PC64:
       *(ul64 *)loc = S + A - P;
       break;
     case R_X86_64_GOT32:
-      write32s(G + A);
+      write32s(G() + A);
       break;
     case R_X86_64_GOT64:
-      *(ul64 *)loc = G + A;
+      *(ul64 *)loc = G() + A;
       break;
     case R_X86_64_GOTOFF64:
     case R_X86_64_PLTOFF64:
@@ -416,10 +436,10 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
       *(ul64 *)loc = GOTPLT + A - P;
       break;
     case R_X86_64_GOTPCREL:
-      write32s(G + GOTPLT + A - P);
+      write32s(G() + GOTPLT + A - P);
       break;
     case R_X86_64_GOTPCREL64:
-      *(ul64 *)loc = G + GOTPLT + A - P;
+      *(ul64 *)loc = G() + GOTPLT + A - P;
       break;
     case R_X86_64_GOTPCRELX:
       // We always want to relax GOTPCRELX relocs even if --no-relax
@@ -435,7 +455,7 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
           break;
         }
       }
-      write32s(G + GOTPLT + A - P);
+      write32s(G() + GOTPLT + A - P);
       break;
     case R_X86_64_REX_GOTPCRELX:
       if (!sym.is_imported && !sym.is_ifunc() && sym.is_relative()) {
@@ -449,25 +469,22 @@ void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
           break;
         }
       }
-      write32s(G + GOTPLT + A - P);
+      write32s(G() + GOTPLT + A - P);
       break;
     case R_X86_64_TLSGD:
       if (sym.has_tlsgd(ctx)) {
         write32s(sym.get_tlsgd_addr(ctx) + A - P);
       } else if (sym.has_gottp(ctx)) {
-        relax_gd_to_ie(loc, rels[i + 1], sym.get_gottp_addr(ctx) - P);
-        i++;
+        relax_gd_to_ie(loc, rels[idx + 1], sym.get_gottp_addr(ctx) - P);
       } else {
-        relax_gd_to_le(loc, rels[i + 1], S - ctx.tp_addr);
-        i++;
+        relax_gd_to_le(loc, rels[idx + 1], S - ctx.tp_addr);
       }
       break;
     case R_X86_64_TLSLD:
       if (ctx.got->has_tlsld(ctx)) {
         write32s(ctx.got->get_tlsld_addr(ctx) + A - P);
       } else {
-        relax_ld_to_le(loc, rels[i + 1], ctx.tp_addr - ctx.tls_begin);
-        i++;
+        relax_ld_to_le(loc, rels[idx + 1], ctx.tp_addr - ctx.tls_begin);
       }
       break;
     case R_X86_64_DTPOFF32:
@@ -641,10 +658,28 @@ void InputSection<E>::scan_relocations(Context<E> &ctx) {
   this->reldyn_offset = file.num_dynrel * sizeof(ElfRel<E>);
   std::span<const ElfRel<E>> rels = get_rels(ctx);
 
+  // Relocations to be applied by apply_reloc_alloc(), grouped by kind.
+  // PC32 and PLT32 relocations go directly to `order`.
+  std::vector<u32> &order = extra.reloc_order;
+  std::vector<u32> abs64;
+  std::vector<u32> others;
+  order.clear();
+  order.reserve(rels.size());
+
   // Scan relocations
   for (i64 i = 0; i < rels.size(); i++) {
     const ElfRel<E> &rel = rels[i];
-    if (rel.r_type == R_NONE || record_undef_error(ctx, rel))
+    if (rel.r_type == R_NONE)
+      continue;
+
+    if (rel.r_type == R_X86_64_PC32 || rel.r_type == R_X86_64_PLT32)
+      order.push_back(i);
+    else if (rel.r_type == R_X86_64_64)
+      abs64.push_back(i);
+    else
+      others.push_back(i);
+
+    if (record_undef_error(ctx, rel))
       continue;
 
     Symbol<E> &sym = *file.symbols[rel.r_sym];
@@ -767,6 +802,11 @@ void InputSection<E>::scan_relocations(Context<E> &ctx) {
       Error(ctx) << *this << ": unknown relocation: " << rel;
     }
   }
+
+  extra.pc32_end = order.size();
+  append(order, std::move(abs64));
+  extra.abs64_end = order.size();
+  append(order, std::move(others));
 }
 
 } // namespace mold::elf
@@ -35,7 +35,7 @@ Options:
   -M, --print-map             Write map file to stdout
   -N, --omagic                Do not page align data, do not make text readonly
     --no-omagic
-  -O NUMBER                   Ignored
+  -O NUMBER                   Set optimization level (-O2 enables string tail merging)
   -S, --strip-debug           Strip .debug_* sections
   -T FILE, --script FILE      Read linker script
   -X, --discard-locals        Discard temporary local symbols
@@ -102,20 +102,37 @@ Options:
                               Set hash style
   --icf=[all,safe,none]       Fold identical code
     --no-icf
+  --icf-hash=[xxh3,sha256]    Select the hash function used by --icf
   --ignore-data-address-equality
                               Allow merging non-executable sections with --icf
   --image-base ADDR           Set the base address to a given value
   --init SYMBOL               Call SYMBOL at load-time
+  --jobserver                 Limit threads by make's jobserver (default)
+    --no-jobserver
+  --library-index             Index library search directories (default)
+    --no-library-index
+  --library-index-cache=FILE  Cache listings of library search directories in FILE
+  --memory-limit=SIZE         Copy output sections in waves to fit in SIZE bytes
+  --no-keep-memory            Release input files' memory as soon as possible
+    --keep-memory
   --no-undefined              Report undefined symbols (even with --shared)
   --noinhibit-exec            Create an output file even if errors occur
+  --numa                      Schedule tasks on NUMA nodes near their data
+    --no-numa
   --oformat=binary            Omit ELF, section and program headers
-  --pack-dyn-relocs=[relr,none]
+  --pack-dyn-relocs=[relr,android,android+relr,none]
                               Pack dynamic relocations
   --package-metadata=STRING   Set a given string to .note.package
   --perf                      Print performance statistics
+  --perf=[text,json,trace:FILE]
+                              Print performance statistics as text or JSON,
+                              or write a trace-event timeline to FILE
+  --perf-counters             Record hardware performance counters for --perf
   --pie, --pic-executable     Create a position independent executable
     --no-pie, --no-pic-executable
   --pop-state                 Restore state of flags governing input file handling
+  --prefetch                  Read input files ahead in the background (default)
+    --no-prefetch
   --print-gc-sections         Print removed unreferenced sections
     --no-print-gc-sections
   --print-icf-sections        Print folded identical sections
@@ -169,6 +186,8 @@ Options:
   -z defs                     Report undefined symbols (even with --shared)
     -z nodefs
   -z common-page-size=VALUE   Ignored
+  -z crel                     Use CREL for --relocatable and --emit-relocs
+    -z nocrel
   -z execstack                Require executable stack
     -z noexecstack
   -z execstack-if-needed      Make the stack area execuable if an input file explicitly requests it
@@ -403,6 +422,7 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
 
   bool version_shown = false;
   bool warn_shared_textrel = false;
+  std::optional<bool> keep_memory;
   std::optional<SeparateCodeKind> z_separate_code;
   std::optional<bool> z_relro;
   std::unordered_set<std::string_view> rpaths;
@@ -609,6 +629,10 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
                                    parse_defsym_value(ctx, arg.substr(pos + 1)));
     } else if (read_flag(":lto-pass2")) {
       ctx.arg.lto_pass2 = true;
+    } else if (read_flag(":lto-api-v0")) {
+      ctx.arg.lto_api_v0 = true;
+    } else if (read_flag(":no-copy-file-range")) {
+      ctx.arg.copy_file_range = false;
     } else if (read_arg(":ignore-ir-file")) {
       ctx.arg.ignore_ir_file.insert(arg);
     } else if (read_flag("demangle")) {
@@ -711,9 +735,28 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.relocatable_merge_sections = true;
     } else if (read_flag("perf")) {
       ctx.arg.perf = true;
+    } else if (read_flag("perf-counters")) {
+      ctx.arg.perf_counters = true;
+    } else if (read_eq("perf")) {
+      if (arg == "text")
+        ctx.arg.perf = true;
+      else if (arg == "json")
+        ctx.arg.perf_json = true;
+      else if (arg.starts_with("trace:") && arg.size() > 6)
+        ctx.arg.perf_trace = arg.substr(6);
+      else
+        Fatal(ctx) << "unknown --perf argument: " << arg;
     } else if (read_flag("pack-dyn-relocs=relr")) {
+      ctx.arg.pack_dyn_relocs_android = false;
+      ctx.arg.pack_dyn_relocs_relr = true;
+    } else if (read_flag("pack-dyn-relocs=android")) {
+      ctx.arg.pack_dyn_relocs_android = true;
+      ctx.arg.pack_dyn_relocs_relr = false;
+    } else if (read_flag("pack-dyn-relocs=android+relr")) {
+      ctx.arg.pack_dyn_relocs_android = true;
       ctx.arg.pack_dyn_relocs_relr = true;
     } else if (read_flag("pack-dyn-relocs=none")) {
+      ctx.arg.pack_dyn_relocs_android = false;
       ctx.arg.pack_dyn_relocs_relr = false;
     } else if (read_arg("package-metadata")) {
       ctx.arg.package_metadata = arg;
@@ -855,6 +898,10 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.z_origin = true;
     } else if (read_z_flag("nodefaultlib")) {
       ctx.arg.z_nodefaultlib = true;
+    } else if (read_z_flag("crel")) {
+      ctx.arg.z_crel = true;
+    } else if (read_z_flag("nocrel")) {
+      ctx.arg.z_crel = false;
     } else if (read_z_flag("pack-relative-relocs")) {
       ctx.arg.pack_dyn_relocs_relr = true;
     } else if (read_z_flag("nopack-relative-relocs")) {
@@ -883,6 +930,18 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.gc_sections = true;
     } else if (read_flag("no-gc-sections")) {
       ctx.arg.gc_sections = false;
+    } else if (read_flag("keep-memory")) {
+      keep_memory = true;
+    } else if (read_flag("no-keep-memory")) {
+      keep_memory = false;
+    } else if (read_flag("jobserver")) {
+      ctx.arg.jobserver = true;
+    } else if (read_flag("no-jobserver")) {
+      ctx.arg.jobserver = false;
+    } else if (read_flag("numa")) {
+      ctx.arg.numa = true;
+    } else if (read_flag("no-numa")) {
+      ctx.arg.numa = false;
     } else if (read_flag("print-gc-sections")) {
       ctx.arg.print_gc_sections = true;
     } else if (read_flag("no-print-gc-sections")) {
@@ -900,6 +959,24 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       }
     } else if (read_flag("no-icf")) {
       ctx.arg.icf = false;
+    } else if (read_flag("library-index")) {
+      ctx.arg.library_index = true;
+    } else if (read_flag("no-library-index")) {
+      ctx.arg.library_index = false;
+    } else if (read_eq("library-index-cache")) {
+      ctx.arg.library_index_cache = arg;
+    } else if (read_eq("memory-limit")) {
+      std::optional<i64> size = parse_size(arg);
+      if (!size)
+        Fatal(ctx) << "invalid --memory-limit argument: " << arg;
+      ctx.arg.memory_limit = *size;
+    } else if (read_eq("icf-hash")) {
+      if (arg == "xxh3")
+        ctx.arg.icf_hash = ICF_HASH_XXH3;
+      else if (arg == "sha256")
+        ctx.arg.icf_hash = ICF_HASH_SHA256;
+      else
+        Fatal(ctx) << "unknown --icf-hash argument: " << arg;
     } else if (read_flag("ignore-data-address-equality")) {
       ctx.arg.ignore_data_address_equality = true;
     } else if (read_arg("image-base")) {
@@ -910,6 +987,10 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.print_icf_sections = true;
     } else if (read_flag("no-print-icf-sections")) {
       ctx.arg.print_icf_sections = false;
+    } else if (read_flag("prefetch")) {
+      ctx.arg.prefetch = true;
+    } else if (read_flag("no-prefetch")) {
+      ctx.arg.prefetch = false;
     } else if (read_flag("quick-exit")) {
       ctx.arg.quick_exit = true;
     } else if (read_flag("no-quick-exit")) {
@@ -1046,10 +1127,14 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.auxiliary.push_back(arg);
     } else if (read_arg("filter") || read_arg("F")) {
       ctx.arg.filter.push_back(arg);
-    } else if (read_arg("O")) {
     } else if (read_flag("O0")) {
+      ctx.arg.optimize = 0;
     } else if (read_flag("O1")) {
+      ctx.arg.optimize = 1;
     } else if (read_flag("O2")) {
+      ctx.arg.optimize = 2;
+    } else if (read_arg("O")) {
+      ctx.arg.optimize = parse_number(ctx, "O", arg);
     } else if (read_flag("verbose")) {
     } else if (read_flag("color-diagnostics")) {
     } else if (read_flag("eh-frame-hdr")) {
@@ -1083,7 +1168,6 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
     } else if (read_z_flag("combreloc")) {
     } else if (read_z_flag("nocombreloc")) {
     } else if (read_z_arg("common-page-size")) {
-    } else if (read_flag("no-keep-memory")) {
     } else if (read_arg("max-cache-size")) {
     } else if (read_arg("version-script")) {
       // --version-script, --dynamic-list and --export-dynamic-symbol[-list]
@@ -1199,6 +1283,12 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
   if (ctx.arg.thread_count == 0)
     ctx.arg.thread_count = get_default_thread_count();
 
+  // --memory-limit implies --no-keep-memory
+  if (keep_memory)
+    ctx.arg.keep_memory = *keep_memory;
+  else if (ctx.arg.memory_limit)
+    ctx.arg.keep_memory = false;
+
   if (char *env = getenv("MOLD_REPRO"); env && env[0])
     ctx.arg.repro = true;
 
@@ -78,6 +78,9 @@ enum : u32 {
   SHT_GROUP = 17,
   SHT_SYMTAB_SHNDX = 18,
   SHT_RELR = 19,
+  SHT_ANDROID_REL = 0x60000001,
+  SHT_ANDROID_RELA = 0x60000002,
+  SHT_CREL = 0x40000014,
   SHT_LLVM_ADDRSIG = 0x6fff4c03,
   SHT_GNU_HASH = 0x6ffffff6,
   SHT_GNU_VERDEF = 0x6ffffffd,
@@ -88,6 +91,10 @@ enum : u32 {
   SHT_ARM_ATTRIBUTES = 0x70000003,
 };
 
+enum : u32 {
+  CREL_HDR_ADDEND = 0x4,
+};
+
 enum : u32 {
   SHF_WRITE = 0x1,
   SHF_ALLOC = 0x2,
@@ -273,6 +280,10 @@ enum : u32 {
   DT_RELRSZ = 35,
   DT_RELR = 36,
   DT_RELRENT = 37,
+  DT_ANDROID_REL = 0x6000000f,
+  DT_ANDROID_RELSZ = 0x60000010,
+  DT_ANDROID_RELA = 0x60000011,
+  DT_ANDROID_RELASZ = 0x60000012,
   DT_GNU_HASH = 0x6ffffef5,
   DT_VERSYM = 0x6ffffff0,
   DT_RELACOUNT = 0x6ffffff9,
@@ -132,14 +132,50 @@ static bool is_eligible(Context<E> &ctx, InputSection<E> &isec) {
          !is_init && !is_fini && !is_enumerable && !is_addr_taken;
 }
 
-static Digest digest_final(SHA256Hash &sha) {
-  u8 buf[SHA256_SIZE];
-  sha.finish(buf);
+// ICF doesn't need a cryptographic hash function because candidate
+// sections are compared byte-by-byte before merging them (see
+// verify_classes). XXH3-128 is the default as it's an order of magnitude
+// faster than SHA-256. SHA-256 can be selected with --icf-hash=sha256.
+class Xxh3Hasher {
+public:
+  Xxh3Hasher() {
+    XXH3_128bits_reset(&state);
+  }
 
-  Digest digest;
-  memcpy(digest.data(), buf, HASH_SIZE);
-  return digest;
-}
+  void update(u8 *data, i64 len) {
+    XXH3_128bits_update(&state, data, len);
+  }
+
+  Digest finish() {
+    XXH128_hash_t hash = XXH3_128bits_digest(&state);
+    Digest digest;
+    memcpy(digest.data(), &hash.low64, 8);
+    memcpy(digest.data() + 8, &hash.high64, 8);
+    return digest;
+  }
+
+private:
+  XXH3_state_t state;
+};
+
+class Sha256Hasher {
+public:
+  void update(u8 *data, i64 len) {
+    sha.update(data, len);
+  }
+
+  Digest finish() {
+    u8 buf[SHA256_SIZE];
+    sha.finish(buf);
+
+    Digest digest;
+    memcpy(digest.data(), buf, HASH_SIZE);
+    return digest;
+  }
+
+private:
+  SHA256Hash sha;
+};
 
 template <typename E>
 static bool is_leaf(Context<E> &ctx, InputSection<E> &isec) {
@@ -232,17 +268,17 @@ static void merge_leaf_nodes(Context<E> &ctx) {
   });
 }
 
-template <typename E>
+template <typename Hasher, typename E>
 static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
-  SHA256Hash sha;
+  Hasher hasher;
 
   auto hash = [&](auto val) {
-    sha.update((u8 *)&val, sizeof(val));
+    hasher.update((u8 *)&val, sizeof(val));
   };
 
   auto hash_string = [&](std::string_view str) {
     hash(str.size());
-    sha.update((u8 *)str.data(), str.size());
+    hasher.update((u8 *)str.data(), str.size());
   };
 
   auto hash_symbol = [&](Symbol<E> &sym) {
@@ -298,7 +334,7 @@ static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
     hash_symbol(*isec.file.symbols[rel.r_sym]);
   }
 
-  return digest_final(sha);
+  return hasher.finish();
 }
 
 template <typename E>
@@ -343,7 +379,10 @@ compute_digests(Context<E> &ctx, std::span<InputSection<E> *> sections) {
 
   std::vector<Digest> digests(sections.size());
   tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
-    digests[i] = compute_digest(ctx, *sections[i]);
+    if (ctx.arg.icf_hash == ICF_HASH_SHA256)
+      digests[i] = compute_digest<Sha256Hasher>(ctx, *sections[i]);
+    else
+      digests[i] = compute_digest<Xxh3Hasher>(ctx, *sections[i]);
   });
   return digests;
 }
@@ -396,7 +435,7 @@ static void gather_edges(Context<E> &ctx,
   });
 }
 
-template <typename E>
+template <typename Hasher>
 static i64 propagate(std::span<std::vector<Digest>> digests,
                      std::span<u32> edges, std::span<u32> edge_indices,
                      bool &slot, BitVector &converged,
@@ -411,16 +450,16 @@ static i64 propagate(std::span<std::vector<Digest>> digests,
     if (converged.get(i))
       return;
 
-    SHA256Hash sha;
-    sha.update(digests[2][i].data(), HASH_SIZE);
+    Hasher hasher;
+    hasher.update(digests[2][i].data(), HASH_SIZE);
 
     i64 begin = edge_indices[i];
     i64 end = (i + 1 == num_digests) ? edges.size() : edge_indices[i + 1];
 
     for (i64 j : edges.subspan(begin, end - begin))
-      sha.update(digests[slot][j].data(), HASH_SIZE);
+      hasher.update(digests[slot][j].data(), HASH_SIZE);
 
-    digests[!slot][i] = digest_final(sha);
+    digests[!slot][i] = hasher.finish();
 
     if (digests[slot][i] == digests[!slot][i]) {
       // This node has converged. Skip further iterations as it will
@@ -449,6 +488,113 @@ static i64 count_num_classes(std::span<Digest> digests,
   return num_classes.combine(std::plus());
 }
 
+// Digests are used only to find candidates for merging. This function
+// double-checks that each section is identical to its leader by comparing
+// their contents and relocations byte-by-byte, so that a hash collision
+// never results in a miscompilation. A relocation target is compared by
+// its leader, so unmerging a section may invalidate other sections that
+// refer to it; we repeat until no more sections are unmerged.
+template <typename E>
+static void verify_classes(Context<E> &ctx,
+                           std::span<InputSection<E> *> sections) {
+  Timer t(ctx, "verify_classes");
+  static Counter false_merges("icf_false_merges");
+
+  auto get_leader = [](InputSection<E> *isec) {
+    return isec->leader ? isec->leader : isec;
+  };
+
+  // Mirrors hash_symbol in compute_digest.
+  auto symbol_equals = [&](Symbol<E> &a, Symbol<E> &b) {
+    if (a.value != b.value)
+      return false;
+    if (!a.file || !b.file)
+      return &a == &b;
+
+    SectionFragment<E> *x = a.get_frag();
+    SectionFragment<E> *y = b.get_frag();
+    if (x || y)
+      return x == y;
+
+    InputSection<E> *isec1 = a.get_input_section();
+    InputSection<E> *isec2 = b.get_input_section();
+    if (!isec1 || !isec2)
+      return !isec1 && !isec2;
+    return get_leader(isec1) == get_leader(isec2);
+  };
+
+  auto rel_equals = [&](InputSection<E> &x, const ElfRel<E> &r1, i64 off1,
+                        InputSection<E> &y, const ElfRel<E> &r2, i64 off2) {
+    return r1.r_offset - off1 == r2.r_offset - off2 &&
+           r1.r_type == r2.r_type &&
+           get_addend(x, r1) == get_addend(y, r2) &&
+           symbol_equals(*x.file.symbols[r1.r_sym], *y.file.symbols[r2.r_sym]);
+  };
+
+  auto equals = [&](InputSection<E> &a, InputSection<E> &b) {
+    if (a.contents != b.contents || a.shdr().sh_flags != b.shdr().sh_flags)
+      return false;
+
+    std::span<const ElfRel<E>> rels1 = a.get_rels(ctx);
+    std::span<const ElfRel<E>> rels2 = b.get_rels(ctx);
+    if (rels1.size() != rels2.size())
+      return false;
+
+    for (i64 i = 0; i < rels1.size(); i++)
+      if (!rel_equals(a, rels1[i], 0, b, rels2[i], 0))
+        return false;
+
+    std::span<FdeRecord<E>> fdes1 = a.get_fdes();
+    std::span<FdeRecord<E>> fdes2 = b.get_fdes();
+    if (fdes1.size() != fdes2.size())
+      return false;
+
+    for (i64 i = 0; i < fdes1.size(); i++) {
+      FdeRecord<E> &x = fdes1[i];
+      FdeRecord<E> &y = fdes2[i];
+
+      if (a.file.cies[x.cie_idx].icf_idx != b.file.cies[y.cie_idx].icf_idx ||
+          x.get_contents(a.file).substr(8) != y.get_contents(b.file).substr(8))
+        return false;
+
+      std::span<ElfRel<E>> rels1 = x.get_rels(a.file);
+      std::span<ElfRel<E>> rels2 = y.get_rels(b.file);
+      if (rels1.size() != rels2.size())
+        return false;
+
+      InputSection<E> &cie1 = a.file.cies[x.cie_idx].input_section;
+      InputSection<E> &cie2 = b.file.cies[y.cie_idx].input_section;
+
+      for (i64 j = 1; j < rels1.size(); j++)
+        if (!rel_equals(cie1, rels1[j], x.input_offset,
+                        cie2, rels2[j], y.input_offset))
+          return false;
+    }
+    return true;
+  };
+
+  std::vector<u8> mismatch(sections.size());
+
+  for (;;) {
+    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
+      InputSection<E> *isec = sections[i];
+      mismatch[i] = (isec->leader != isec && !equals(*isec, *isec->leader));
+    });
+
+    i64 num_mismatches = 0;
+    for (i64 i = 0; i < sections.size(); i++) {
+      if (mismatch[i]) {
+        sections[i]->leader = sections[i];
+        num_mismatches++;
+      }
+    }
+
+    if (num_mismatches == 0)
+      break;
+    false_merges += num_mismatches;
+  }
+}
+
 template <typename E>
 static void print_icf_sections(Context<E> &ctx) {
   tbb::concurrent_vector<InputSection<E> *> leaders;
@@ -539,9 +685,17 @@ void icf_sections(Context<E> &ctx) {
     // the call tree depth.
     // Here, we test whether we have reached sufficient depth for the latter,
     // which is a necessary (but not sufficient) condition for convergence.
+    auto do_propagate = [&] {
+      if (ctx.arg.icf_hash == ICF_HASH_SHA256)
+        return propagate<Sha256Hasher>(digests, edges, edge_indices, slot,
+                                       converged, ap);
+      return propagate<Xxh3Hasher>(digests, edges, edge_indices, slot,
+                                   converged, ap);
+    };
+
     i64 num_changed = -1;
     for (;;) {
-      i64 n = propagate<E>(digests, edges, edge_indices, slot, converged, ap);
+      i64 n = do_propagate();
       if (n == num_changed)
         break;
       num_changed = n;
@@ -554,7 +708,7 @@ void icf_sections(Context<E> &ctx) {
       // count_num_classes requires sorting which is O(n log n), so do a little
       // more work beforehand to amortize that log factor.
       for (i64 i = 0; i < 10; i++)
-        propagate<E>(digests, edges, edge_indices, slot, converged, ap);
+        do_propagate();
 
       i64 n = count_num_classes<E>(digests[slot], ap);
       if (n == num_classes)
@@ -563,7 +717,7 @@ void icf_sections(Context<E> &ctx) {
     }
   }
 
-  // Group sections by SHA digest.
+  // Group sections by digest.
   {
     Timer t(ctx, "group");
 
@@ -587,6 +741,8 @@ void icf_sections(Context<E> &ctx) {
     ctx.on_exit.push_back([=] { delete map; });
   }
 
+  verify_classes(ctx, std::span(sections));
+
   if (ctx.arg.print_icf_sections)
     print_icf_sections(ctx);
 
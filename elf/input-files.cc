@@ -8,6 +8,12 @@
 # include <unistd.h>
 #endif
 
+#if defined(__SSE2__)
+# include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+#endif
+
 namespace mold::elf {
 
 template <typename E>
@@ -193,6 +199,7 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
     case SHT_STRTAB:
     case SHT_REL:
     case SHT_RELA:
+    case SHT_CREL:
     case SHT_NULL:
     case SHT_ARM_ATTRIBUTES:
       break;
@@ -304,7 +311,8 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
   // Attach relocation sections to their target sections.
   for (i64 i = 0; i < this->elf_sections.size(); i++) {
     const ElfShdr<E> &shdr = this->elf_sections[i];
-    if (shdr.sh_type != (E::is_rela ? SHT_RELA : SHT_REL))
+    if (shdr.sh_type != (E::is_rela ? SHT_RELA : SHT_REL) &&
+        shdr.sh_type != SHT_CREL)
       continue;
 
     if (shdr.sh_info >= sections.size())
@@ -314,10 +322,91 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
     if (std::unique_ptr<InputSection<E>> &target = sections[shdr.sh_info]) {
       assert(target->relsec_idx == -1);
       target->relsec_idx = i;
+
+      // CREL relocations are decoded on first use by get_crels(), so
+      // that we don't decode them for sections that turn out to be
+      // discarded.
+      if (shdr.sh_type == SHT_CREL && decoded_crels.empty()) {
+        decoded_crels.resize(this->elf_sections.size());
+        decoded_crels_once.reset(new std::once_flag[this->elf_sections.size()]);
+      }
     }
   }
 }
 
+// SHT_CREL is a compact relocation section format. It begins with a
+// ULEB128 header containing the number of relocations, a flag indicating
+// whether relocations have explicit addends, and a shift amount that is
+// applied to all r_offsets. Each relocation is encoded as a delta from
+// the previous one; the first byte contains the low bits of the r_offset
+// delta and flags indicating which of the symbol index, type and addend
+// have changed, and the changed fields follow as SLEB128 deltas.
+template <typename E>
+void ObjectFile<E>::decode_crel(Context<E> &ctx, i64 shndx) {
+  const ElfShdr<E> &shdr = this->elf_sections[shndx];
+  std::string_view data = this->get_string(ctx, shdr);
+  u8 *p = (u8 *)data.data();
+  u8 *end = p + data.size();
+
+  u64 hdr = read_uleb(p);
+  i64 count = hdr / 8;
+  bool has_addend = hdr & CREL_HDR_ADDEND;
+  i64 flag_bits = has_addend ? 3 : 2;
+  i64 shift = hdr % CREL_HDR_ADDEND;
+
+  if (has_addend && !E::is_rela)
+    Fatal(ctx) << *this << ": CREL with explicit addends is not supported"
+               << " for this target";
+
+  // On RELA targets, we don't read addends from section contents, so
+  // CREL without explicit addends would silently get zero addends.
+  // Compilers don't emit such sections for RELA targets.
+  if (!has_addend && E::is_rela && count)
+    Fatal(ctx) << *this << ": CREL with implicit addends is not supported"
+               << " for this target";
+
+  std::vector<ElfRel<E>> &vec = decoded_crels[shndx];
+  vec.reserve(count);
+
+  // Offsets and addends wrap around at the target's word size.
+  using UWord = std::conditional_t<E::is_64, u64, u32>;
+  UWord offset = 0;
+  UWord addend = 0;
+  u32 sym = 0;
+  u32 type = 0;
+
+  for (i64 i = 0; i < count; i++) {
+    if (end <= p)
+      Fatal(ctx) << *this << ": corrupted CREL section";
+
+    u8 byte = *p++;
+    offset += byte >> flag_bits;
+    if (byte & 0x80)
+      offset += (read_uleb(p) << (7 - flag_bits)) - (0x80 >> flag_bits);
+
+    if (byte & 1)
+      sym += read_sleb(p);
+    if (byte & 2)
+      type += read_sleb(p);
+    if (has_addend && (byte & 4))
+      addend += read_sleb(p);
+
+    vec.emplace_back(offset << shift, type, sym,
+                     (std::make_signed_t<UWord>)addend);
+  }
+
+  if (end < p)
+    Fatal(ctx) << *this << ": corrupted CREL section";
+}
+
+// Returns decoded relocations of a given CREL section. This function
+// may be called from multiple threads for the same section.
+template <typename E>
+std::span<ElfRel<E>> ObjectFile<E>::get_crels(Context<E> &ctx, i64 shndx) {
+  std::call_once(decoded_crels_once[shndx], [&] { decode_crel(ctx, shndx); });
+  return decoded_crels[shndx];
+}
+
 template <typename E>
 void ObjectFile<E>::initialize_ehframe_sections(Context<E> &ctx) {
   for (i64 i = 0; i < sections.size(); i++) {
@@ -558,6 +647,122 @@ static size_t find_null(std::string_view data, u64 entsize) {
   return data.npos;
 }
 
+// Returns a bitmask whose Nth bit is set if the entsize-byte character
+// at buf[N] is a null character. Only bits at multiples of entsize are
+// set. `size` must be 64 or less.
+template <i64 ENTSIZE>
+static u64 find_nulls_scalar(const u8 *buf, i64 size) {
+  u64 mask = 0;
+  for (i64 i = 0; i + ENTSIZE <= size; i += ENTSIZE) {
+    bool is_null = true;
+    for (i64 j = 0; j < ENTSIZE; j++)
+      is_null = is_null && buf[i + j] == 0;
+    mask |= (u64)is_null << i;
+  }
+  return mask;
+}
+
+// This is the same as find_nulls_scalar(buf, 64) but uses SIMD
+// instructions if available.
+template <i64 ENTSIZE>
+static u64 find_nulls(const u8 *buf) {
+#if defined(__AVX2__)
+  __m256i zero = _mm256_setzero_si256();
+
+  auto cmp = [&](const u8 *p) -> u64 {
+    __m256i v = _mm256_loadu_si256((__m256i *)p);
+    if constexpr (ENTSIZE == 1)
+      return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    else if constexpr (ENTSIZE == 2)
+      return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, zero)) & 0x5555'5555;
+    else
+      return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, zero)) & 0x1111'1111;
+  };
+
+  return cmp(buf) | (cmp(buf + 32) << 32);
+#elif defined(__SSE2__)
+  __m128i zero = _mm_setzero_si128();
+
+  auto cmp = [&](const u8 *p) -> u64 {
+    __m128i v = _mm_loadu_si128((__m128i *)p);
+    if constexpr (ENTSIZE == 1)
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    else if constexpr (ENTSIZE == 2)
+      return _mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) & 0x5555;
+    else
+      return _mm_movemask_epi8(_mm_cmpeq_epi32(v, zero)) & 0x1111;
+  };
+
+  return cmp(buf) | (cmp(buf + 16) << 16) | (cmp(buf + 32) << 32) |
+         (cmp(buf + 48) << 48);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  // NEON doesn't have an equivalent of movemask, so we compute it by
+  // masking each byte with its bit position and adding them up.
+  static const u8 weights[] = {1, 2, 4, 8, 16, 32, 64, 128,
+                               1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t w = vld1q_u8(weights);
+
+  auto cmp = [&](const u8 *p) -> u64 {
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t eq;
+    if constexpr (ENTSIZE == 1)
+      eq = vceqzq_u8(v);
+    else if constexpr (ENTSIZE == 2)
+      eq = vreinterpretq_u8_u16(vceqzq_u16(vreinterpretq_u16_u8(v)));
+    else
+      eq = vreinterpretq_u8_u32(vceqzq_u32(vreinterpretq_u32_u8(v)));
+
+    uint8x16_t m = vandq_u8(eq, w);
+    u64 bits = vaddv_u8(vget_low_u8(m)) | (vaddv_u8(vget_high_u8(m)) << 8);
+    if constexpr (ENTSIZE == 2)
+      return bits & 0x5555;
+    else if constexpr (ENTSIZE == 4)
+      return bits & 0x1111;
+    return bits;
+  };
+
+  return cmp(buf) | (cmp(buf + 16) << 16) | (cmp(buf + 32) << 32) |
+         (cmp(buf + 48) << 48);
+#else
+  return find_nulls_scalar<ENTSIZE>(buf, 64);
+#endif
+}
+
+// Splits a given string section into null-terminated strings and
+// appends them and their hashes to `rec`. We scan the section contents
+// in 64-byte blocks to find all string terminators in each block at
+// once, so this function touches each byte only once besides hashing.
+//
+// Returns false if the last string is not null-terminated.
+template <typename E, i64 ENTSIZE>
+static bool split_strings(MergeableSection<E> &rec, std::string_view data) {
+  const u8 *buf = (const u8 *)data.data();
+  i64 size = data.size();
+  i64 begin = 0;
+
+  auto add = [&](i64 end) {
+    std::string_view substr = data.substr(begin, end - begin);
+    rec.strings.push_back(substr);
+    rec.frag_offsets.push_back(begin);
+    rec.hashes.push_back(hash_string(substr));
+    begin = end;
+  };
+
+  for (i64 pos = 0; pos < size; pos += 64) {
+    u64 mask;
+    if (pos + 64 <= size)
+      mask = find_nulls<ENTSIZE>(buf + pos);
+    else
+      mask = find_nulls_scalar<ENTSIZE>(buf + pos, size - pos);
+
+    while (mask) {
+      add(pos + std::countr_zero(mask) + ENTSIZE);
+      mask &= mask - 1;
+    }
+  }
+  return begin == size;
+}
+
 // Mergeable sections (sections with SHF_MERGE bit) typically contain
 // string literals. Linker is expected to split the section contents
 // into null-terminated strings, merge them with mergeable strings
@@ -610,21 +815,37 @@ split_section(Context<E> &ctx, InputSection<E> &sec) {
       entsize = 1;
     }
 
-    while (!data.empty()) {
-      size_t end = find_null(data, entsize);
-      if (end == data.npos)
-        Fatal(ctx) << sec << ": string is not null terminated";
+    bool ok = true;
 
-      std::string_view substr = data.substr(0, end + entsize);
-      data = data.substr(end + entsize);
+    switch (entsize) {
+    case 1:
+      ok = split_strings<E, 1>(*rec, data);
+      break;
+    case 2:
+      ok = split_strings<E, 2>(*rec, data);
+      break;
+    case 4:
+      ok = split_strings<E, 4>(*rec, data);
+      break;
+    default:
+      while (!data.empty()) {
+        size_t end = find_null(data, entsize);
+        if (end == data.npos) {
+          ok = false;
+          break;
+        }
 
-      rec->strings.push_back(substr);
-      rec->frag_offsets.push_back(substr.data() - begin);
+        std::string_view substr = data.substr(0, end + entsize);
+        data = data.substr(end + entsize);
 
-      u64 hash = hash_string(substr);
-      rec->hashes.push_back(hash);
-      estimator.insert(hash);
+        rec->strings.push_back(substr);
+        rec->frag_offsets.push_back(substr.data() - begin);
+        rec->hashes.push_back(hash_string(substr));
+      }
     }
+
+    if (!ok)
+      Fatal(ctx) << sec << ": string is not null terminated";
   } else {
     // OCaml compiler seems to create a mergeable non-string section with
     // entisze of 0. Such section is malformed. We do not split such section.
@@ -640,17 +861,16 @@ split_section(Context<E> &ctx, InputSection<E> &sec) {
 
       rec->strings.push_back(substr);
       rec->frag_offsets.push_back(substr.data() - begin);
-
-      u64 hash = hash_string(substr);
-      rec->hashes.push_back(hash);
-      estimator.insert(hash);
+      rec->hashes.push_back(hash_string(substr));
     }
   }
 
+  for (u64 hash : rec->hashes)
+    estimator.insert(hash);
   rec->parent->estimator.merge(estimator);
 
   static Counter counter("string_fragments");
-  counter += rec->fragments.size();
+  counter += rec->strings.size();
   return rec;
 }
 
@@ -1474,6 +1694,29 @@ void SharedFile<E>::populate_symtab(Context<E> &ctx) {
   }
 }
 
+// For --stats. Returns the approximate number of bytes used by this
+// file's data structures, excluding the input sections allocated from
+// the arena and the mapped file contents.
+template <typename E>
+i64 ObjectFile<E>::get_memory_usage() const {
+  i64 size = sizeof(*this) +
+             sections.capacity() * sizeof(sections[0]) +
+             this->symbols.capacity() * sizeof(Symbol<E> *) +
+             this->local_syms.capacity() * sizeof(Symbol<E>) +
+             this->frag_syms.capacity() * sizeof(Symbol<E>) +
+             cies.capacity() * sizeof(CieRecord<E>) +
+             fdes.capacity() * sizeof(FdeRecord<E>);
+
+  for (const std::unique_ptr<MergeableSection<E>> &m : mergeable_sections)
+    if (m)
+      size += sizeof(*m) +
+              m->strings.capacity() * sizeof(m->strings[0]) +
+              m->hashes.capacity() * sizeof(m->hashes[0]) +
+              m->frag_offsets.capacity() * sizeof(m->frag_offsets[0]) +
+              m->fragments.capacity() * sizeof(m->fragments[0]);
+  return size;
+}
+
 using E = MOLD_TARGET;
 
 template class InputFile<E>;
@@ -1,8 +1,6 @@
 #include "mold.h"
 
 #include <limits>
-#include <zlib.h>
-#include <zstd.h>
 
 namespace mold::elf {
 
@@ -73,6 +71,7 @@ void InputSection<E>::uncompress(Context<E> &ctx) {
   uncompress_to(ctx, buf);
   contents = std::string_view((char *)buf, sh_size);
   ctx.string_pool.emplace_back(buf);
+  ctx.string_pool_size += sh_size;
   uncompressed = true;
 }
 
@@ -90,15 +89,12 @@ void InputSection<E>::uncompress_to(Context<E> &ctx, u8 *buf) {
   std::string_view data = contents.substr(sizeof(ElfChdr<E>));
 
   switch (hdr.ch_type) {
-  case ELFCOMPRESS_ZLIB: {
-    unsigned long size = sh_size;
-    if (::uncompress(buf, &size, (u8 *)data.data(), data.size()) != Z_OK)
+  case ELFCOMPRESS_ZLIB:
+    if (!zlib_decompress(data, buf, sh_size))
       Fatal(ctx) << *this << ": uncompress failed";
-    assert(size == sh_size);
     break;
-  }
   case ELFCOMPRESS_ZSTD:
-    if (ZSTD_decompress(buf, sh_size, (u8 *)data.data(), data.size()) != sh_size)
+    if (!zstd_decompress(data, buf, sh_size))
       Fatal(ctx) << *this << ": ZSTD_decompress failed";
     break;
   default:
@@ -107,6 +103,74 @@ void InputSection<E>::uncompress_to(Context<E> &ctx, u8 *buf) {
   }
 }
 
+// Large non-alloc sections such as .debug_info are copied to the output
+// file as-is and then patched by relocations. For such sections, we let
+// the kernel copy data from the input file to the output file using
+// copy_file_range(2), which avoids moving data through user space. On
+// filesystems supporting reflink such as XFS or Btrfs, the kernel may
+// even share disk blocks between the two files instead of copying them.
+//
+// `buf` must point into the memory-mapped view of `out`. Returns false
+// if the section cannot be copied that way, in which case the caller is
+// expected to copy it by itself.
+template <typename E>
+bool InputSection<E>::copy_file_range_to(Context<E> &ctx,
+                                         OutputFile<Context<E>> &out,
+                                         u8 *buf) {
+#ifdef __linux__
+  constexpr i64 min_size = 64 * 1024;
+  static std::atomic_bool disabled = false;
+
+  if (disabled || !ctx.arg.copy_file_range || sh_size < min_size ||
+      (shdr().sh_flags & SHF_ALLOC) || (shdr().sh_flags & SHF_COMPRESSED) ||
+      uncompressed || out.fd == -1 || buf < out.buf ||
+      out.buf + out.filesize < buf + sh_size)
+    return false;
+
+  // Archive members share the mapping with their archive file.
+  MappedFile<Context<E>> *mf = file.mf;
+  while (mf->parent)
+    mf = mf->parent;
+
+  if ((u8 *)contents.data() < mf->data ||
+      mf->data + mf->size < (u8 *)contents.data() + sh_size)
+    return false;
+
+  // We don't keep input files open because a large program may consist
+  // of more files than the file descriptor limit, so we reopen the file
+  // and make sure that it is the same one as we mapped.
+  int fd = ::open(mf->name.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  bool ok = (fstat(fd, &st) == 0 && st.st_dev == mf->dev &&
+             st.st_ino == mf->ino && st.st_size == mf->size &&
+             get_mtime_nsec(st) == mf->mtime_nsec);
+
+  loff_t in_off = (u8 *)contents.data() - mf->data;
+  loff_t out_off = buf - out.buf;
+  i64 remaining = sh_size;
+
+  while (ok && remaining > 0) {
+    ssize_t n = copy_file_range(fd, &in_off, out.fd, &out_off, remaining, 0);
+    if (n <= 0) {
+      // Don't try again if the kernel or the filesystem doesn't support it.
+      if (n == -1 && (errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP))
+        disabled = true;
+      ok = false;
+      break;
+    }
+    remaining -= n;
+  }
+
+  ::close(fd);
+  return ok;
+#else
+  return false;
+#endif
+}
+
 template <typename E>
 static Action get_rel_action(Context<E> &ctx, Symbol<E> &sym,
                              const Action table[3][4]) {
@@ -395,13 +459,18 @@ void InputSection<E>::apply_toc_rel(Context<E> &ctx, Symbol<E> &sym,
                get_ppc64_toc_action(ctx, sym));
 }
 
+// If `out` is not null, `buf` points into the memory-mapped view of the
+// output file `out`, and the section contents may be copied by the kernel.
 template <typename E>
-void InputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
+void InputSection<E>::write_to(Context<E> &ctx, u8 *buf,
+                               OutputFile<Context<E>> *out) {
   if (shdr().sh_type == SHT_NOBITS || sh_size == 0)
     return;
 
   // Copy data
-  if constexpr (is_riscv<E>) {
+  if (out && copy_file_range_to(ctx, *out, buf)) {
+    // The kernel copied the data for us
+  } else if constexpr (is_riscv<E>) {
     copy_contents_riscv(ctx, buf);
   } else {
     uncompress_to(ctx, buf);
@@ -416,6 +485,53 @@ void InputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
   }
 }
 
+// For --no-keep-memory. Input files are memory-mapped, and their pages
+// stay resident until the process exits even though most of them are no
+// longer needed once they are copied to the output file. This function
+// is called after this section is written to ask the kernel to reclaim
+// the pages of this section and its relocations.
+//
+// Input files are mapped with MAP_PRIVATE, and some passes modify their
+// contents in place (e.g. RISC-V sorts relocations). MADV_DONTNEED would
+// discard such changes, so we use MADV_PAGEOUT instead, which drops clean
+// pages and swaps out modified ones. Either way, a page that is accessed
+// again later (e.g. to write .symtab) is read back with its contents
+// intact.
+template <typename E>
+void InputSection<E>::release_pages() {
+#ifdef MADV_PAGEOUT
+  if (!file.mf)
+    return;
+
+  MappedFile<Context<E>> *mf = file.mf;
+  while (mf->parent)
+    mf = mf->parent;
+
+  // An archive member shares pages with its neighbors, so we release
+  // only pages that are entirely within the given range.
+  auto release = [&](const u8 *data, i64 size) {
+    if (!mf->data || data < mf->data || mf->data + mf->size < data + size)
+      return;
+
+    static const u64 page_size = sysconf(_SC_PAGESIZE);
+    u64 begin = align_to((u64)data, page_size);
+    u64 end = ((u64)data + size) & ~(page_size - 1);
+    if (data + size == mf->data + mf->size)
+      end = align_to((u64)data + size, page_size);
+
+    if (begin < end)
+      madvise((void *)begin, end - begin, MADV_PAGEOUT);
+  };
+
+  release((u8 *)contents.data(), contents.size());
+
+  if (relsec_idx != -1) {
+    const ElfShdr<E> &shdr = file.elf_sections[relsec_idx];
+    release(file.mf->data + shdr.sh_offset, shdr.sh_size);
+  }
+#endif
+}
+
 // Get the name of a function containin a given offset.
 template <typename E>
 std::string_view InputSection<E>::get_func_name(Context<E> &ctx, i64 offset) const {
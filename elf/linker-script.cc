@@ -176,11 +176,9 @@ static MappedFile<Context<E>> *resolve_path(Context<E> &ctx, std::string_view to
   if (MappedFile<Context<E>> *mf = open_library(ctx, str))
     return mf;
 
-  for (std::string_view dir : ctx.arg.library_paths) {
-    std::string path = std::string(dir) + "/" + str;
-    if (MappedFile<Context<E>> *mf = open_library(ctx, path))
+  for (std::string_view dir : ctx.arg.library_paths)
+    if (MappedFile<Context<E>> *mf = open_library(ctx, dir, str))
       return mf;
-  }
 
   SyntaxError(ctx, tok) << "library not found: " << str;
 }
@@ -72,8 +72,9 @@
 //
 //  5. `all_symbols_read_hook` "returns" the result by calling the
 //     `add_input_file` callback. The callback is called with a path to an
-//     LTO'ed ELF file. We parse that ELF file and override symbols
-//     defined by IR objects with the ELF file's ones.
+//     LTO'ed ELF file. We parse that ELF file in the background and,
+//     once the hook returns, override symbols defined by IR objects
+//     with the ELF files' ones.
 //
 //  6. Lastly, we call `cleanup_hook` to remove temporary files created by
 //     the compiler backend.
@@ -103,6 +104,7 @@ namespace mold::elf {
 
 template <typename E> static Context<E> *gctx;
 template <typename E> static std::vector<ObjectFile<E> *> lto_objects;
+template <typename E> static std::vector<ObjectFile<E> *> unclaimed_objects;
 
 static int phase = 0;
 static std::vector<PluginSymbol> plugin_symbols;
@@ -184,8 +186,12 @@ static PluginStatus add_input_file(const char *path) {
 
   file->priority = file_priority++;
   file->is_alive = true;
-  file->parse(ctx);
-  file->resolve_symbols(ctx);
+
+  // LLVM and GCC plugins call this function after all backend jobs
+  // have finished, once for each output file. Parse the files in the
+  // background so that they are parsed in parallel with each other.
+  // Symbols are resolved in do_lto() once all files have been added.
+  ctx.tg.run([file, &ctx] { file->parse(ctx); });
   return LDPS_OK;
 }
 
@@ -336,6 +342,10 @@ get_symbols(const void *handle, int nsyms, PluginSymbol *psyms, bool is_v2) {
 // the linker has to ignore, so that it won't read the object files
 // from archives next time.
 //
+// We usually avoid this by not passing archive members to the plugin
+// until we know they are alive (see claim_live_files()), so this is
+// needed only if that didn't work for some input file.
+//
 // This is an ugly hack and should be removed once GCC adopts the v3 API.
 template <typename E>
 static void restart_process(Context<E> &ctx) {
@@ -355,6 +365,10 @@ static void restart_process(Context<E> &ctx) {
   std::cout << std::flush;
   std::cerr << std::flush;
 
+  // The new process will acquire job slots again.
+  if (ctx.jobserver)
+    ctx.jobserver->release();
+
   std::string self = get_self_path();
   execv(self.c_str(), (char * const *)args.data());
   std::cerr << "execv failed: " << errno_string() << "\n";
@@ -432,13 +446,23 @@ get_api_version(const char *plugin_identifier,
   *linker_identifier = "mold";
   *linker_version = version.data();
 
-  if (LAPI_V1 <= maximal_api_supported) {
+  // --:lto-api-v0 is for testing. It lets us test the code path for
+  // GCC plugins that don't support the v3 API with a newer GCC.
+  if (LAPI_V1 <= maximal_api_supported &&
+      (!gctx<E>->arg.lto_api_v0 || LAPI_V0 < minimal_api_supported)) {
     is_gcc_linker_api_v1 = true;
     return LAPI_V1;
   }
   return LAPI_V0;
 }
 
+// Returns true if a given linker plugin looks like LLVM's one.
+// Returns false if it's GCC.
+template <typename E>
+static bool is_llvm(Context<E> &ctx) {
+  return ctx.arg.plugin.ends_with("LLVMgold.so");
+}
+
 template <typename E>
 static void load_plugin(Context<E> &ctx) {
   assert(phase == 0);
@@ -471,6 +495,18 @@ static void load_plugin(Context<E> &ctx) {
   for (std::string_view opt : ctx.arg.plugin_opt)
     tv.emplace_back(LDPT_OPTION, save(opt));
 
+  // LLVM runs as many LTO backend threads as the number of cores by
+  // default. If we are under make's jobserver, cap it by the number of
+  // job slots we have unless the user specified it explicitly.
+  auto is_jobs = [](std::string_view opt) { return opt.starts_with("jobs="); };
+
+  if (ctx.jobserver && is_llvm(ctx) &&
+      std::none_of(ctx.arg.plugin_opt.begin(), ctx.arg.plugin_opt.end(),
+                   is_jobs)) {
+    i64 n = ctx.jobserver->num_threads();
+    tv.emplace_back(LDPT_OPTION, save("jobs=" + std::to_string(n)));
+  }
+
   tv.emplace_back(LDPT_REGISTER_CLAIM_FILE_HOOK, register_claim_file_hook<E>);
   tv.emplace_back(LDPT_REGISTER_ALL_SYMBOLS_READ_HOOK,
                   register_all_symbols_read_hook<E>);
@@ -561,13 +597,6 @@ static ElfSym<E> to_elf_sym(PluginSymbol &psym) {
   return esym;
 }
 
-// Returns true if a given linker plugin looks like LLVM's one.
-// Returns false if it's GCC.
-template <typename E>
-static bool is_llvm(Context<E> &ctx) {
-  return ctx.arg.plugin.ends_with("LLVMgold.so");
-}
-
 // Returns true if a given linker plugin supports the get_symbols_v3 API.
 // Any version of LLVM and GCC 12 or newer support it.
 template <typename E>
@@ -575,33 +604,11 @@ static bool supports_v3_api(Context<E> &ctx) {
   return is_gcc_linker_api_v1 || is_llvm(ctx);
 }
 
+// Passes a given IR object to the plugin. claim_file_hook() calls
+// add_symbols() which initializes `plugin_symbols`.
 template <typename E>
-ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mf) {
-  // V0 API's claim_file is not thread-safe.
-  static std::mutex mu;
-  std::unique_lock lock(mu, std::defer_lock);
-  if (!is_gcc_linker_api_v1)
-    lock.lock();
-
-  if (ctx.arg.plugin.empty())
-    Fatal(ctx) << mf->name << ": don't know how to handle this LTO object file "
-               << "because no -plugin option was given. Please make sure you "
-               << "added -flto not only for creating object files but also for "
-               << "creating the final executable.";
-
-  // dlopen the linker plugin file
-  static std::once_flag flag;
-  std::call_once(flag, [&] { load_plugin(ctx); });
-
-  // Create mold's object instance
-  ObjectFile<E> *obj = new ObjectFile<E>;
-  ctx.obj_pool.emplace_back(obj);
-
-  obj->filename = mf->name;
-  obj->symbols.push_back(new Symbol<E>);
-  obj->first_global = 1;
-  obj->is_lto_obj = true;
-  obj->mf = mf;
+static void claim_file(Context<E> &ctx, ObjectFile<E> *obj) {
+  MappedFile<Context<E>> *mf = obj->mf;
 
   // Create plugin's object instance
   PluginInputFile file = {};
@@ -614,16 +621,12 @@ ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mf) {
   if (file.fd == -1)
     Fatal(ctx) << "cannot open " << file.name << ": " << errno_string();
 
-  if (mf->parent)
-    obj->archive_name = mf->parent->name;
-
   file.offset = mf->get_offset();
   file.filesize = mf->size;
   file.handle = (void *)obj;
 
   LOG << "read_lto_symbols: "<< mf->name << "\n";
 
-  // claim_file_hook() calls add_symbols() which initializes `plugin_symbols`
   int claimed = false;
   claim_file_hook(&file, &claimed);
   if (!claimed)
@@ -638,27 +641,228 @@ ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mf) {
     close(mf2->fd);
     mf2->fd = -1;
   }
+}
 
-  // Initialize object symbols
+template <typename E>
+static void
+set_symbols(Context<E> &ctx, ObjectFile<E> *obj, std::span<PluginSymbol> psyms) {
   std::vector<ElfSym<E>> *esyms = new std::vector<ElfSym<E>>(1);
+  obj->symbols.resize(1);
 
-  for (PluginSymbol &psym : plugin_symbols) {
+  for (PluginSymbol &psym : psyms) {
     esyms->push_back(to_elf_sym<E>(psym));
     obj->symbols.push_back(get_symbol(ctx, save_string(ctx, psym.name)));
   }
 
   obj->elf_syms = *esyms;
+  obj->has_symver = {};
   obj->has_symver.resize(esyms->size());
+}
+
+// Reads the symbol table of a GCC IR object in the same way as GCC's
+// LTO plugin does, so that we can resolve symbols without passing the
+// file to the plugin. Symbol names point to the mapped file. Returns
+// false if the file is not in the form we expect.
+//
+// The symbol table is a sequence of entries, each of which consists of
+// a NUL-terminated name, a NUL-terminated comdat key, a symbol kind, a
+// visibility, a 64-bit size and a 32-bit slot number.
+template <typename E>
+static bool read_gcc_symtab(MappedFile<Context<E>> *mf,
+                            std::vector<PluginSymbol> &psyms) {
+  const char *data = mf->get_contents().data();
+  u64 size = mf->size;
+
+  if (size < sizeof(ElfEhdr<E>))
+    return false;
+
+  ElfEhdr<E> &ehdr = *(ElfEhdr<E> *)data;
+  if (ehdr.e_shnum == 0 || ehdr.e_shstrndx == SHN_XINDEX ||
+      ehdr.e_shstrndx >= ehdr.e_shnum || size < ehdr.e_shoff ||
+      (size - ehdr.e_shoff) / sizeof(ElfShdr<E>) < ehdr.e_shnum)
+    return false;
+
+  std::span<ElfShdr<E>> shdrs{(ElfShdr<E> *)(data + ehdr.e_shoff), ehdr.e_shnum};
+
+  // Returns the contents of a section, or nullopt if it is out of bounds.
+  auto get_contents = [&](ElfShdr<E> &sec) -> std::optional<std::string_view> {
+    if (sec.sh_type == SHT_NOBITS)
+      return std::string_view();
+    if (size < sec.sh_offset || size - sec.sh_offset < sec.sh_size)
+      return {};
+    return std::string_view(data + sec.sh_offset, sec.sh_size);
+  };
+
+  std::optional<std::string_view> shstrtab =
+    get_contents(shdrs[ehdr.e_shstrndx]);
+  if (!shstrtab)
+    return false;
+
+  std::string_view symtab;
+
+  for (ElfShdr<E> &sec : shdrs) {
+    if (shstrtab->size() <= sec.sh_name)
+      return false;
+
+    std::string_view name = shstrtab->substr(sec.sh_name);
+    name = name.substr(0, name.find('\0'));
+
+    if (name == ".gnu.lto_.symtab" || name.starts_with(".gnu.lto_.symtab.")) {
+      // The plugin merges symbol tables of an object file created by
+      // `ld -r` and removes duplicates. We don't bother to mimic that.
+      std::optional<std::string_view> contents = get_contents(sec);
+      if (!symtab.empty() || !contents)
+        return false;
+      symtab = *contents;
+    }
+  }
+
+  if (symtab.empty())
+    return false;
+
+  static const PluginSymbolKind kinds[] = {
+    LDPK_DEF, LDPK_WEAKDEF, LDPK_UNDEF, LDPK_WEAKUNDEF, LDPK_COMMON,
+  };
+
+  static const PluginSymbolVisibility visibilities[] = {
+    LDPV_DEFAULT, LDPV_PROTECTED, LDPV_INTERNAL, LDPV_HIDDEN,
+  };
+
+  while (!symtab.empty()) {
+    // A leading \1 indicates that the name is not to be prefixed.
+    if (symtab[0] == '\1')
+      symtab = symtab.substr(1);
+
+    size_t pos = symtab.find('\0');
+    if (pos == symtab.npos)
+      return false;
+    std::string_view name = symtab.substr(0, pos);
+    symtab = symtab.substr(pos + 1);
+
+    pos = symtab.find('\0');
+    if (pos == symtab.npos || symtab.size() < pos + 15)
+      return false;
+    symtab = symtab.substr(pos + 1);
+
+    u8 kind = symtab[0];
+    u8 visibility = symtab[1];
+    if (kind >= std::size(kinds) || visibility >= std::size(visibilities))
+      return false;
+    symtab = symtab.substr(14);
+
+    PluginSymbol psym = {};
+    psym.name = (char *)name.data();
+    psym.def = kinds[kind];
+    psym.visibility = visibilities[visibility];
+    psyms.push_back(psym);
+  }
+  return true;
+}
+
+template <typename E>
+ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                               bool is_in_lib) {
+  // V0 API's claim_file is not thread-safe.
+  static std::mutex mu;
+  std::unique_lock lock(mu, std::defer_lock);
+  if (!is_gcc_linker_api_v1)
+    lock.lock();
+
+  if (ctx.arg.plugin.empty())
+    Fatal(ctx) << mf->name << ": don't know how to handle this LTO object file "
+               << "because no -plugin option was given. Please make sure you "
+               << "added -flto not only for creating object files but also for "
+               << "creating the final executable.";
+
+  // dlopen the linker plugin file
+  static std::once_flag flag;
+  std::call_once(flag, [&] { load_plugin(ctx); });
+
+  // Create mold's object instance
+  ObjectFile<E> *obj = new ObjectFile<E>;
+  ctx.obj_pool.emplace_back(obj);
+
+  obj->filename = mf->name;
+  obj->symbols.push_back(new Symbol<E>);
+  obj->first_global = 1;
+  obj->is_lto_obj = true;
+  obj->mf = mf;
+
+  if (mf->parent)
+    obj->archive_name = mf->parent->name;
+
+  // If the plugin doesn't support the v3 API, we can't take a file
+  // back once we pass it to the plugin. So we don't pass a file that
+  // may not be included to the output until we know it will be. See
+  // claim_live_files().
+  if (is_in_lib && !ctx.arg.lto_pass2 && !supports_v3_api(ctx)) {
+    std::vector<PluginSymbol> psyms;
+    if (read_gcc_symtab(mf, psyms)) {
+      set_symbols(ctx, obj, psyms);
+      unclaimed_objects<E>.push_back(obj);
+      return obj;
+    }
+  }
+
+  claim_file(ctx, obj);
+  set_symbols(ctx, obj, plugin_symbols);
   plugin_symbols.clear();
   return obj;
 }
 
+// Passes archive members that were deferred by read_lto_object() to
+// the plugin now that we know which ones are alive. Returns false if
+// we still have to restart the process.
+template <typename E>
+static bool claim_live_files(Context<E> &ctx) {
+  Timer t(ctx, "claim_live_files");
+
+  i64 num_dead = 0;
+  for (std::unique_ptr<ObjectFile<E>> &file : ctx.obj_pool)
+    if (file->is_lto_obj && !file->is_alive)
+      num_dead++;
+
+  // If a file passed to the plugin turned out to be dead, we can't
+  // unload it.
+  for (ObjectFile<E> *file : unclaimed_objects<E>)
+    if (!file->is_alive)
+      num_dead--;
+
+  if (num_dead)
+    return false;
+
+  for (ObjectFile<E> *file : unclaimed_objects<E>) {
+    if (!file->is_alive)
+      continue;
+
+    claim_file(ctx, file);
+
+    // Make sure that the plugin sees the same symbols as we did;
+    // otherwise, our symbol resolution may have been wrong.
+    if (plugin_symbols.size() + 1 != file->elf_syms.size())
+      return false;
+
+    for (i64 i = 0; i < plugin_symbols.size(); i++) {
+      ElfSym<E> esym = to_elf_sym<E>(plugin_symbols[i]);
+      ElfSym<E> &esym2 = file->elf_syms[i + 1];
+
+      if (file->symbols[i + 1]->name() != plugin_symbols[i].name ||
+          esym.st_shndx != esym2.st_shndx || esym.st_bind != esym2.st_bind)
+        return false;
+    }
+
+    set_symbols(ctx, file, plugin_symbols);
+    plugin_symbols.clear();
+  }
+  return true;
+}
+
 // Entry point
 template <typename E>
 std::vector<ObjectFile<E> *> do_lto(Context<E> &ctx) {
   Timer t(ctx, "do_lto");
 
-  if (!ctx.arg.lto_pass2 && !supports_v3_api(ctx))
+  if (!ctx.arg.lto_pass2 && !supports_v3_api(ctx) && !claim_live_files(ctx))
     restart_process(ctx);
 
   assert(phase == 1);
@@ -692,11 +896,23 @@ std::vector<ObjectFile<E> *> do_lto(Context<E> &ctx) {
     get_symbol(ctx, y)->referenced_by_regular_obj = true;
   }
 
+  // GCC's lto-wrapper runs LTRANS jobs in parallel using make's
+  // jobserver if available. Give our job slots back while it's running.
+  if (ctx.jobserver && !is_llvm(ctx))
+    ctx.jobserver->release();
+
   // all_symbols_read_hook() calls add_input_file() and add_input_library()
   LOG << "all symbols read\n";
   if (PluginStatus st = all_symbols_read_hook(); st != LDPS_OK)
     Fatal(ctx) << "LTO: all_symbols_read_hook returns " << st;
 
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
+  ctx.tg.wait();
+  tbb::parallel_for_each(lto_objects<E>, [&](ObjectFile<E> *file) {
+    file->resolve_symbols(ctx);
+  });
   return lto_objects<E>;
 }
 
@@ -710,7 +926,7 @@ void lto_cleanup(Context<E> &ctx) {
 
 using E = MOLD_TARGET;
 
-template ObjectFile<E> *read_lto_object(Context<E> &, MappedFile<Context<E>> *);
+template ObjectFile<E> *read_lto_object(Context<E> &, MappedFile<Context<E>> *, bool);
 template std::vector<ObjectFile<E> *> do_lto(Context<E> &);
 template void lto_cleanup(Context<E> &);
 
@@ -4,6 +4,7 @@
 #include "../common/output-file.h"
 
 #include <cstring>
+#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <map>
@@ -106,6 +107,17 @@ check_file_compatibility(Context<E> &ctx, MappedFile<Context<E>> *mf) {
                << ctx.arg.emulation << " is expected but got " << target;
 }
 
+// Input files are parsed in the background. With --numa, they are
+// assigned to NUMA nodes in a round-robin fashion so that their pages
+// are distributed evenly to the nodes.
+template <typename E, typename T>
+static void parse_file(Context<E> &ctx, T *file) {
+  if (ctx.numa)
+    ctx.numa->run(file->priority, [file, &ctx] { file->parse(ctx); });
+  else
+    ctx.tg.run([file, &ctx] { file->parse(ctx); });
+}
+
 template <typename E>
 static ObjectFile<E> *new_object_file(Context<E> &ctx, MappedFile<Context<E>> *mf,
                                       std::string archive_name) {
@@ -117,7 +129,7 @@ static ObjectFile<E> *new_object_file(Context<E> &ctx, MappedFile<Context<E>> *m
   bool in_lib = ctx.in_lib || (!archive_name.empty() && !ctx.whole_archive);
   ObjectFile<E> *file = ObjectFile<E>::create(ctx, mf, archive_name, in_lib);
   file->priority = ctx.file_priority++;
-  ctx.tg.run([file, &ctx] { file->parse(ctx); });
+  parse_file(ctx, file);
   if (ctx.arg.trace)
     SyncOut(ctx) << "trace: " << *file;
   return file;
@@ -132,11 +144,12 @@ static ObjectFile<E> *new_lto_obj(Context<E> &ctx, MappedFile<Context<E>> *mf,
   if (ctx.arg.ignore_ir_file.count(mf->get_identifier()))
     return nullptr;
 
-  ObjectFile<E> *file = read_lto_object(ctx, mf);
+  bool in_lib = ctx.in_lib || (!archive_name.empty() && !ctx.whole_archive);
+  ObjectFile<E> *file = read_lto_object(ctx, mf, in_lib);
   file->priority = ctx.file_priority++;
   file->archive_name = archive_name;
-  file->is_in_lib = ctx.in_lib || (!archive_name.empty() && !ctx.whole_archive);
-  file->is_alive = !file->is_in_lib;
+  file->is_in_lib = in_lib;
+  file->is_alive = !in_lib;
   ctx.has_lto_object = true;
   if (ctx.arg.trace)
     SyncOut(ctx) << "trace: " << *file;
@@ -150,7 +163,7 @@ new_shared_file(Context<E> &ctx, MappedFile<Context<E>> *mf) {
 
   SharedFile<E> *file = SharedFile<E>::create(ctx, mf);
   file->priority = ctx.file_priority++;
-  ctx.tg.run([file, &ctx] { file->parse(ctx); });
+  parse_file(ctx, file);
   if (ctx.arg.trace)
     SyncOut(ctx) << "trace: " << *file;
   return file;
@@ -230,23 +243,31 @@ MappedFile<Context<E>> *open_library(Context<E> &ctx, std::string path) {
   return nullptr;
 }
 
+// Opens `dir/name` unless the library index knows that it doesn't
+// exist.
+template <typename E>
+MappedFile<Context<E>> *
+open_library(Context<E> &ctx, std::string_view dir, std::string_view name) {
+  if (ctx.library_index && !ctx.library_index->may_contain(dir, name))
+    return nullptr;
+  return open_library(ctx, std::string(dir) + "/" + std::string(name));
+}
+
 template <typename E>
 MappedFile<Context<E>> *find_library(Context<E> &ctx, std::string name) {
   if (name.starts_with(':')) {
-    for (std::string_view dir : ctx.arg.library_paths) {
-      std::string path = std::string(dir) + "/" + name.substr(1);
-      if (MappedFile<Context<E>> *mf = open_library(ctx, path))
+    for (std::string_view dir : ctx.arg.library_paths)
+      if (MappedFile<Context<E>> *mf = open_library(ctx, dir, name.substr(1)))
         return mf;
-    }
     Fatal(ctx) << "library not found: " << name;
   }
 
   for (std::string_view dir : ctx.arg.library_paths) {
-    std::string stem = std::string(dir) + "/lib" + name;
+    std::string stem = "lib" + name;
     if (!ctx.is_static)
-      if (MappedFile<Context<E>> *mf = open_library(ctx, stem + ".so"))
+      if (MappedFile<Context<E>> *mf = open_library(ctx, dir, stem + ".so"))
         return mf;
-    if (MappedFile<Context<E>> *mf = open_library(ctx, stem + ".a"))
+    if (MappedFile<Context<E>> *mf = open_library(ctx, dir, stem + ".a"))
       return mf;
   }
   Fatal(ctx) << "library not found: " << name;
@@ -258,12 +279,59 @@ MappedFile<Context<E>> *find_from_search_paths(Context<E> &ctx, std::string name
     return mf;
 
   for (std::string_view dir : ctx.arg.library_paths)
-    if (MappedFile<Context<E>> *mf =
-        MappedFile<Context<E>>::open(ctx, std::string(dir) + "/" + name))
-      return mf;
+    if (!ctx.library_index || ctx.library_index->may_contain(dir, name))
+      if (MappedFile<Context<E>> *mf =
+          MappedFile<Context<E>>::open(ctx, std::string(dir) + "/" + name))
+        return mf;
   return nullptr;
 }
 
+// Returns the paths of input files in the command line order for
+// Prefetcher. A library given by `-l` is guessed from the library
+// index, so the result may not exactly match what we will read.
+template <typename E>
+static std::vector<std::string>
+get_prefetch_paths(Context<E> &ctx, std::span<std::string> args) {
+  std::vector<std::string> vec;
+  bool is_static = ctx.arg.is_static;
+
+  auto add = [&](std::string path) {
+    if (path.starts_with('/') && !ctx.arg.chroot.empty())
+      path = ctx.arg.chroot + "/" + path_clean(path);
+    vec.push_back(path);
+  };
+
+  for (std::string_view arg : args) {
+    if (arg == "--Bstatic") {
+      is_static = true;
+    } else if (arg == "--Bdynamic") {
+      is_static = false;
+    } else if (remove_prefix(arg, "-l")) {
+      if (arg.starts_with(':'))
+        continue;
+
+      // Without the index, we'd have to probe the file system here.
+      if (!ctx.library_index)
+        continue;
+
+      std::string stem = "lib" + std::string(arg);
+      for (std::string_view dir : ctx.arg.library_paths) {
+        if (!is_static && ctx.library_index->may_contain(dir, stem + ".so")) {
+          add(std::string(dir) + "/" + stem + ".so");
+          break;
+        }
+        if (ctx.library_index->may_contain(dir, stem + ".a")) {
+          add(std::string(dir) + "/" + stem + ".a");
+          break;
+        }
+      }
+    } else if (!arg.starts_with('-')) {
+      add(std::string(arg));
+    }
+  }
+  return vec;
+}
+
 template <typename E>
 static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
   Timer t(ctx, "read_input_files");
@@ -271,6 +339,15 @@ static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
   std::vector<std::tuple<bool, bool, bool, bool>> state;
   ctx.is_static = ctx.arg.is_static;
 
+  if (ctx.arg.library_index)
+    ctx.library_index.reset(new DirectoryIndex(ctx.arg.library_paths,
+                                               ctx.arg.library_index_cache));
+
+  // Start reading input files into the page cache so that parse
+  // tasks don't have to wait for the disk one page at a time.
+  if (ctx.arg.prefetch)
+    ctx.prefetcher.reset(new Prefetcher(get_prefetch_paths(ctx, args)));
+
   while (!args.empty()) {
     std::string_view arg = args[0];
     args = args.subspan(1);
@@ -334,6 +411,8 @@ static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
     Fatal(ctx) << "no input files";
 
   ctx.tg.wait();
+  if (ctx.numa)
+    ctx.numa->wait();
 }
 
 // Since elf_main is a template, we can't run it without a type parameter.
@@ -416,9 +495,27 @@ int elf_main(int argc, char **argv) {
     on_complete = fork_child();
 #endif
 
+  // Hardware counters count events only of threads created after they
+  // are opened, so we need to open them before TBB spawns workers.
+  if (ctx.arg.perf_counters && !open_hw_counters())
+    Warn(ctx) << "--perf-counters: hardware performance counters are not"
+              << " available: " << errno_string();
+
   tbb::global_control tbb_cont(tbb::global_control::max_allowed_parallelism,
                                ctx.arg.thread_count);
 
+  if (ctx.arg.numa)
+    ctx.numa = NumaScheduler::create(ctx.arg.thread_count);
+
+  // If we are invoked by `make -jN`, use only as many threads as the
+  // number of job slots we can get from make, so that parallel links
+  // don't oversubscribe CPUs. We try to get more slots at the beginning
+  // of each major phase.
+  if (ctx.arg.jobserver)
+    ctx.jobserver = JobServer::create(ctx.arg.thread_count);
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
   // Handle --wrap options if any.
   for (std::string_view name : ctx.arg.wrap)
     get_symbol(ctx, name)->is_wrapped = true;
@@ -442,6 +539,9 @@ int elf_main(int argc, char **argv) {
     });
   }
 
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
   Timer t_total(ctx, "total");
   Timer t_before_copy(ctx, "before_copy");
 
@@ -464,6 +564,13 @@ int elf_main(int argc, char **argv) {
   // put together in a single phase.
   resolve_symbols(ctx);
 
+  // Now that we know which archive members are needed, read them
+  // ahead. So far, only the parts needed for parsing have been read.
+  if (ctx.prefetcher)
+    for (ObjectFile<E> *file : ctx.objs)
+      if (!file->archive_name.empty())
+        ctx.prefetcher->add(file->mf->data, file->mf->size);
+
   // "Kill" .eh_frame input sections after symbol resolution.
   kill_eh_frame_sections(ctx);
 
@@ -588,6 +695,9 @@ int elf_main(int argc, char **argv) {
   if constexpr (is_ppc64v1<E>)
     ppc64v1_scan_symbols(ctx);
 
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
   // Scan relocations to find symbols that need entries in .got, .plt,
   // .got.plt, .dynsym, .dynstr, etc.
   scan_relocations(ctx);
@@ -658,15 +768,30 @@ int elf_main(int argc, char **argv) {
   // Set actual addresses to linker-synthesized symbols.
   fix_synthetic_symbols(ctx);
 
+  // If --pack-dyn-relocs=android is given, compute the size of the
+  // packed .rel.dyn and assign addresses again.
+  if (ctx.reldyn->shdr.sh_type == SHT_ANDROID_REL ||
+      ctx.reldyn->shdr.sh_type == SHT_ANDROID_RELA)
+    filesize = set_android_reldyn_size(ctx, filesize);
+
   // Beyond this, you can assume that symbol addresses including their
   // GOT or PLT addresses have a correct final value.
 
-  // If --compress-debug-sections is given, compress .debug_* sections
-  // using zlib.
+  // If -z crel is given with --emit-relocs, encode relocation sections
+  // now that we know their contents, and assign file offsets again.
+  if (ctx.arg.emit_relocs && ctx.arg.z_crel) {
+    construct_crel(ctx);
+    filesize = set_osec_offsets(ctx);
+  }
+
+  // If --compress-debug-sections is given, start compressing .debug_*
+  // sections in the background. Compressed sections are placed at the
+  // end of the file and written after all the other sections.
   if (ctx.arg.compress_debug_sections != COMPRESS_NONE)
     filesize = compress_debug_sections(ctx);
 
-  // At this point, both memory and file layouts are fixed.
+  // At this point, both memory and file layouts are fixed except for
+  // compressed debug sections.
 
   t_before_copy.stop();
 
@@ -675,10 +800,14 @@ int elf_main(int argc, char **argv) {
     OutputFile<Context<E>>::open(ctx, ctx.arg.output, filesize, 0777);
   ctx.buf = ctx.output_file->buf;
 
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
   Timer t_copy(ctx, "copy");
 
   // Copy input sections to the output file and apply relocations.
   copy_chunks(ctx);
+  ctx.prefetcher.reset();
 
   // Some part of .gdb_index couldn't be computed until other debug
   // sections are complete. We have complete debug sections now, so
@@ -690,6 +819,12 @@ int elf_main(int argc, char **argv) {
   // so we sort them.
   ctx.reldyn->sort(ctx);
 
+  // If --pack-dyn-relocs=android was given, write .rel.dyn in the
+  // Android packed relocation format.
+  if (ctx.reldyn->shdr.sh_type == SHT_ANDROID_REL ||
+      ctx.reldyn->shdr.sh_type == SHT_ANDROID_RELA)
+    ctx.reldyn->pack_android(ctx);
+
   // Zero-clear paddings between sections
   clear_padding(ctx);
 
@@ -702,6 +837,11 @@ int elf_main(int argc, char **argv) {
   t_copy.stop();
   ctx.checkpoint();
 
+  // The rest of the work is mostly serial. Give the job slots back to
+  // make before closing the output file, which may take a while.
+  if (ctx.jobserver)
+    ctx.jobserver->release();
+
   // Close the output file. This is the end of the linker's main job.
   ctx.output_file->close(ctx);
 
@@ -725,6 +865,17 @@ int elf_main(int argc, char **argv) {
   if (ctx.arg.perf)
     print_timer_records(ctx.timer_records);
 
+  if (ctx.arg.perf_json)
+    print_timer_records_json(ctx.timer_records, std::cout);
+
+  if (!ctx.arg.perf_trace.empty()) {
+    std::ofstream out(ctx.arg.perf_trace);
+    if (!out.is_open())
+      Fatal(ctx) << "cannot open " << ctx.arg.perf_trace << ": "
+                 << errno_string();
+    print_timer_records_trace(ctx.timer_records, out);
+  }
+
   std::cout << std::flush;
   std::cerr << std::flush;
   if (on_complete)
@@ -743,6 +894,8 @@ using E = MOLD_TARGET;
 
 template void read_file(Context<E> &, MappedFile<Context<E>> *);
 template MappedFile<Context<E>> *open_library(Context<E> &, std::string);
+template MappedFile<Context<E>> *
+open_library(Context<E> &, std::string_view, std::string_view);
 
 #ifdef MOLD_X86_64
 
@@ -69,6 +69,10 @@ struct SectionFragment {
   u32 offset = -1;
   Atomic<u8> p2align = 0;
   Atomic<bool> is_alive = false;
+
+  // True if this string is a suffix of another string and was placed
+  // in the middle of that string by tail merging (-O2).
+  bool is_tail_merged = false;
 };
 
 // Additional class members for dynamic symbols. Because most symbols
@@ -226,6 +230,17 @@ struct InputSectionExtras<E> {
   std::vector<i32> r_deltas;
 };
 
+// scan_relocations() sorts relocations by the way they are applied so
+// that apply_reloc_alloc() can process each group in a tight loop.
+// `reloc_order` holds relocation indices; [0, pc32_end) are PC32/PLT32,
+// [pc32_end, abs64_end) are R_X86_64_64 and the rest are others.
+template <typename E> requires is_x86_64<E>
+struct InputSectionExtras<E> {
+  std::vector<u32> reloc_order;
+  u32 pc32_end = 0;
+  u32 abs64_end = 0;
+};
+
 // InputSection represents a section in an input object file.
 template <typename E>
 class InputSection {
@@ -233,10 +248,17 @@ public:
   InputSection(Context<E> &ctx, ObjectFile<E> &file, std::string_view name,
                i64 shndx);
 
+  static void *operator new(size_t size) { return arena_alloc(size); }
+  static void operator delete(void *) {}
+
   void uncompress(Context<E> &ctx);
   void uncompress_to(Context<E> &ctx, u8 *buf);
+  bool copy_file_range_to(Context<E> &ctx, OutputFile<Context<E>> &out,
+                          u8 *buf);
   void scan_relocations(Context<E> &ctx);
-  void write_to(Context<E> &ctx, u8 *buf);
+  void write_to(Context<E> &ctx, u8 *buf,
+                OutputFile<Context<E>> *out = nullptr);
+  void release_pages();
   void apply_reloc_alloc(Context<E> &ctx, u8 *base);
   void apply_reloc_nonalloc(Context<E> &ctx, u8 *base);
   void kill();
@@ -362,6 +384,20 @@ public:
   virtual void write_to(Context<E> &ctx, u8 *buf) { unreachable(); }
   virtual void update_shdr(Context<E> &ctx) {}
 
+  // For streamed compression. A chunk can be split into pieces that can
+  // be written independently. get_piece_offsets() returns the piece
+  // boundaries including 0 and sh_size, and write_piece() writes the
+  // bytes in [begin, end) of this chunk, where `begin` and `end` are
+  // adjacent boundaries. By default, a chunk consists of a single piece.
+  virtual std::vector<i64> get_piece_offsets(Context<E> &ctx) {
+    return {0, (i64)shdr.sh_size};
+  }
+
+  virtual void write_piece(Context<E> &ctx, u8 *buf, i64 begin, i64 end) {
+    assert(begin == 0 && end == shdr.sh_size);
+    write_to(ctx, buf);
+  }
+
   // For --gdb-index
   virtual u8 *get_uncompressed_data() { return nullptr; }
 
@@ -461,6 +497,8 @@ public:
   OutputSection<E> *to_osec() override { return this; }
   void copy_buf(Context<E> &ctx) override;
   void write_to(Context<E> &ctx, u8 *buf) override;
+  std::vector<i64> get_piece_offsets(Context<E> &ctx) override;
+  void write_piece(Context<E> &ctx, u8 *buf, i64 begin, i64 end) override;
 
   void compute_symtab_size(Context<E> &ctx) override;
   void populate_symtab(Context<E> &ctx) override;
@@ -472,6 +510,20 @@ public:
 
   std::vector<std::unique_ptr<RangeExtensionThunk<E>>> thunks;
   std::unique_ptr<RelocSection<E>> reloc_sec;
+
+private:
+  void write_members(Context<E> &ctx, u8 *buf, OutputFile<Context<E>> *out);
+
+  // An input section spanning more than one piece is written to a
+  // temporary buffer once, and each piece copies its part from it.
+  struct SplitSection {
+    std::once_flag once;
+    std::unique_ptr<u8[]> buf;
+    std::atomic<i64> num_pieces = 0;
+  };
+
+  std::unordered_map<InputSection<E> *, std::unique_ptr<SplitSection>>
+    split_sections;
 };
 
 template <typename E>
@@ -499,6 +551,7 @@ public:
   bool has_tlsld(Context<E> &ctx) const { return tlsld_idx != -1; }
   i64 get_reldyn_size(Context<E> &ctx) const override;
   void copy_buf(Context<E> &ctx) override;
+  void write_to(Context<E> &ctx, u8 *buf) override;
 
   void compute_symtab_size(Context<E> &ctx) override;
   void populate_symtab(Context<E> &ctx) override;
@@ -604,6 +657,23 @@ public:
 
   void update_shdr(Context<E> &ctx) override;
   void sort(Context<E> &ctx);
+  std::vector<u8> encode_android(Context<E> &ctx);
+  void pack_android(Context<E> &ctx);
+
+  // Returns the buffer to which dynamic relocations are written. If
+  // the section is in the Android packed format, they are written to
+  // a separate buffer and then encoded to the output file.
+  u8 *get_buf(Context<E> &ctx) {
+    if (!unpacked_buf.empty())
+      return unpacked_buf.data();
+    return ctx.buf + this->shdr.sh_offset;
+  }
+
+  // The size reserved for the packed relocations, or -1 if not known yet
+  i64 android_size = -1;
+
+private:
+  std::vector<u8> unpacked_buf;
 };
 
 template <typename E>
@@ -777,12 +847,22 @@ public:
   void assign_offsets(Context<E> &ctx);
   void copy_buf(Context<E> &ctx) override;
   void write_to(Context<E> &ctx, u8 *buf) override;
+  std::vector<i64> get_piece_offsets(Context<E> &ctx) override;
+  void write_piece(Context<E> &ctx, u8 *buf, i64 begin, i64 end) override;
   void print_stats(Context<E> &ctx);
+  i64 get_memory_usage() const { return map.get_memory_usage(); }
 
   HyperLogLog estimator;
 
 private:
+  struct TailMergedFragment {
+    SectionFragment<E> *frag;
+    SectionFragment<E> *leader;
+    u32 delta;
+  };
+
   MergedSection(std::string_view name, u64 flags, u32 type);
+  std::vector<TailMergedFragment> tail_merge(Context<E> &ctx);
 
   ConcurrentMap<SectionFragment<E>> map;
   std::vector<i64> shard_offsets;
@@ -851,6 +931,7 @@ public:
   void update_shdr(Context<E> &ctx) override;
   i64 get_reldyn_size(Context<E> &ctx) const override { return symbols.size(); }
   void copy_buf(Context<E> &ctx) override;
+  void write_to(Context<E> &ctx, u8 *buf) override;
 
   bool is_relro;
   std::vector<Symbol<E> *> symbols;
@@ -1011,10 +1092,13 @@ template <typename E>
 class CompressedSection : public Chunk<E> {
 public:
   CompressedSection(Context<E> &ctx, Chunk<E> &chunk);
+  void compress(Context<E> &ctx);
+  void update_shdr(Context<E> &ctx) override;
   void copy_buf(Context<E> &ctx) override;
   u8 *get_uncompressed_data() override { return uncompressed.get(); }
 
 private:
+  Chunk<E> &chunk;
   ElfChdr<E> chdr = {};
   std::unique_ptr<Compressor> compressed;
   std::unique_ptr<u8[]> uncompressed;
@@ -1025,11 +1109,13 @@ class RelocSection : public Chunk<E> {
 public:
   RelocSection(Context<E> &ctx, OutputSection<E> &osec);
   void update_shdr(Context<E> &ctx) override;
+  void construct_crel(Context<E> &ctx);
   void copy_buf(Context<E> &ctx) override;
 
 private:
   OutputSection<E> &output_section;
   std::vector<i64> offsets;
+  std::vector<u8> crel;
 };
 
 // PT_GNU_RELRO works on page granularity. We want to align its end to
@@ -1119,6 +1205,9 @@ template <typename E>
 struct MergeableSection {
   std::pair<SectionFragment<E> *, i64> get_fragment(i64 offset);
 
+  static void *operator new(size_t size) { return arena_alloc(size); }
+  static void operator delete(void *) {}
+
   MergedSection<E> *parent;
   u8 p2align = 0;
   std::vector<std::string_view> strings;
@@ -1210,6 +1299,8 @@ public:
   void convert_common_symbols(Context<E> &ctx);
   void compute_symtab_size(Context<E> &ctx);
   void populate_symtab(Context<E> &ctx);
+  i64 get_memory_usage() const;
+  std::span<ElfRel<E>> get_crels(Context<E> &ctx, i64 shndx);
 
   i64 get_shndx(const ElfSym<E> &esym);
   InputSection<E> *get_section(const ElfSym<E> &esym);
@@ -1221,6 +1312,8 @@ public:
   std::vector<ElfShdr<E>> elf_sections2;
   std::vector<CieRecord<E>> cies;
   std::vector<FdeRecord<E>> fdes;
+  std::vector<std::vector<ElfRel<E>>> decoded_crels;
+  std::unique_ptr<std::once_flag[]> decoded_crels_once;
   BitVector has_symver;
   std::vector<ComdatGroupRef<E>> comdat_groups;
   bool exclude_libs = false;
@@ -1264,6 +1357,7 @@ private:
   void initialize_sections(Context<E> &ctx);
   void initialize_symbols(Context<E> &ctx);
   void sort_relocations(Context<E> &ctx);
+  void decode_crel(Context<E> &ctx, i64 shndx);
   void initialize_ehframe_sections(Context<E> &ctx);
   void read_note_gnu_property(Context <E> &ctx, const ElfShdr <E> &shdr);
   void read_ehframe(Context<E> &ctx, InputSection<E> &isec);
@@ -1337,7 +1431,8 @@ void parse_dynamic_list(Context<E> &ctx, MappedFile<Context<E>> *mf);
 //
 
 template <typename E>
-ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mb);
+ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mb,
+                               bool is_in_lib);
 
 template <typename E>
 std::vector<ObjectFile<E> *> do_lto(Context<E> &ctx);
@@ -1421,6 +1516,7 @@ template <typename E> void construct_relr(Context<E> &);
 template <typename E> void create_output_symtab(Context<E> &);
 template <typename E> void report_undef_errors(Context<E> &);
 template <typename E> void create_reloc_sections(Context<E> &);
+template <typename E> void construct_crel(Context<E> &);
 template <typename E> void copy_chunks(Context<E> &);
 template <typename E> void apply_version_script(Context<E> &);
 template <typename E> void parse_symbol_version(Context<E> &);
@@ -1430,6 +1526,7 @@ template <typename E> void clear_padding(Context<E> &);
 template <typename E> void compute_section_headers(Context<E> &);
 template <typename E> i64 set_osec_offsets(Context<E> &);
 template <typename E> void fix_synthetic_symbols(Context<E> &);
+template <typename E> i64 set_android_reldyn_size(Context<E> &, i64);
 template <typename E> i64 compress_debug_sections(Context<E> &);
 template <typename E> void write_dependency_file(Context<E> &);
 template <typename E> void show_stats(Context<E> &);
@@ -1466,6 +1563,7 @@ public:
   void add_symbol(Context<PPC64V1> &ctx, Symbol<PPC64V1> *sym);
   i64 get_reldyn_size(Context<PPC64V1> &ctx) const override;
   void copy_buf(Context<PPC64V1> &ctx) override;
+  void write_to(Context<PPC64V1> &ctx, u8 *buf) override;
 
   static constexpr i64 ENTRY_SIZE = sizeof(Word<PPC64V1>) * 3;
 
@@ -1507,6 +1605,7 @@ public:
   u64 get_addr(Symbol<ALPHA> &sym, i64 addend);
   i64 get_reldyn_size(Context<ALPHA> &ctx) const override;
   void copy_buf(Context<ALPHA> &ctx) override;
+  void write_to(Context<ALPHA> &ctx, u8 *buf) override;
 
   struct Entry {
     bool operator==(const Entry &) const = default;
@@ -1533,6 +1632,8 @@ struct BuildId {
 
 typedef enum { COMPRESS_NONE, COMPRESS_ZLIB, COMPRESS_ZSTD } CompressKind;
 
+typedef enum { ICF_HASH_XXH3, ICF_HASH_SHA256 } IcfHashKind;
+
 typedef enum {
   UNRESOLVED_ERROR,
   UNRESOLVED_WARN,
@@ -1618,6 +1719,7 @@ struct Context {
     BuildId build_id;
     CetReportKind z_cet_report = CET_REPORT_NONE;
     CompressKind compress_debug_sections = COMPRESS_NONE;
+    IcfHashKind icf_hash = ICF_HASH_XXH3;
     SeparateCodeKind z_separate_code = NOSEPARATE_CODE;
     ShuffleSectionsKind shuffle_sections = SHUFFLE_SECTIONS_NONE;
     UnresolvedKind unresolved_symbols = UNRESOLVED_ERROR;
@@ -1626,6 +1728,7 @@ struct Context {
     bool allow_multiple_definition = false;
     bool apply_dynamic_relocs = true;
     bool color_diagnostics = false;
+    bool copy_file_range = true;
     bool default_symver = false;
     bool demangle = true;
     bool discard_all = false;
@@ -1645,14 +1748,23 @@ struct Context {
     bool icf_all = false;
     bool ignore_data_address_equality = false;
     bool is_static = false;
+    bool jobserver = true;
+    bool keep_memory = true;
+    bool library_index = true;
+    bool lto_api_v0 = false;
     bool lto_pass2 = false;
     bool noinhibit_exec = false;
+    bool numa = false;
     bool oformat_binary = false;
     bool omagic = false;
+    bool pack_dyn_relocs_android = false;
     bool pack_dyn_relocs_relr = false;
     bool perf = false;
+    bool perf_counters = false;
+    bool perf_json = false;
     bool pic = false;
     bool pie = false;
+    bool prefetch = true;
     bool print_dependencies = false;
     bool print_gc_sections = false;
     bool print_icf_sections = false;
@@ -1675,6 +1787,7 @@ struct Context {
     bool warn_once = false;
     bool warn_textrel = false;
     bool z_copyreloc = true;
+    bool z_crel = false;
     bool z_defs = false;
     bool z_delete = true;
     bool z_dlopen = true;
@@ -1693,6 +1806,8 @@ struct Context {
     bool z_shstk = false;
     bool z_text = false;
     i64 filler = -1;
+    i64 memory_limit = 0;
+    i64 optimize = 0;
     i64 spare_dynamic_tags = 5;
     i64 thread_count = 0;
     std::string_view emulation;
@@ -1707,8 +1822,10 @@ struct Context {
     std::string entry = "_start";
     std::string fini = "_fini";
     std::string init = "_init";
+    std::string library_index_cache;
     std::string output = "a.out";
     std::string package_metadata;
+    std::string perf_trace;
     std::string plugin;
     std::string rpaths;
     std::string soname;
@@ -1749,8 +1866,12 @@ struct Context {
   bool has_error = false;
   bool has_lto_object = false;
 
+  // Errors and warnings are discarded while this is set. This is for
+  // passes that are run ahead of time only to compute something.
+  bool suppress_diagnostics = false;
+
   // Symbol table
-  tbb::concurrent_hash_map<std::string_view, Symbol<E>, HashCmp> symbol_map;
+  tbb::concurrent_hash_map<std::string_view, Symbol<E> *, HashCmp> symbol_map;
   tbb::concurrent_hash_map<std::string_view, ComdatGroup, HashCmp> comdat_groups;
   tbb::concurrent_vector<std::unique_ptr<MergedSection<E>>> merged_sections;
 
@@ -1760,6 +1881,7 @@ struct Context {
   tbb::concurrent_vector<std::unique_ptr<ObjectFile<E>>> obj_pool;
   tbb::concurrent_vector<std::unique_ptr<SharedFile<E>>> dso_pool;
   tbb::concurrent_vector<std::unique_ptr<u8[]>> string_pool;
+  std::atomic<i64> string_pool_size = 0;
   tbb::concurrent_vector<std::unique_ptr<MappedFile<Context<E>>>> mf_pool;
   tbb::concurrent_vector<std::unique_ptr<Chunk<E>>> chunk_pool;
   tbb::concurrent_vector<std::unique_ptr<OutputSection<E>>> osec_pool;
@@ -1782,6 +1904,22 @@ struct Context {
   u8 *buf = nullptr;
   bool overwrite_output_file = true;
 
+  // .debug_* sections are compressed in the background while
+  // other sections are copied to the output file.
+  tbb::task_group compress_tg;
+
+  // For --numa
+  std::unique_ptr<NumaScheduler> numa;
+
+  // For --jobserver
+  std::unique_ptr<JobServer> jobserver;
+
+  // For --prefetch
+  std::unique_ptr<Prefetcher> prefetcher;
+
+  // For library search
+  std::unique_ptr<DirectoryIndex> library_index;
+
   std::vector<Chunk<E> *> chunks;
   std::atomic_bool needs_tlsld = false;
   std::atomic_bool has_textrel = false;
@@ -1873,6 +2011,10 @@ std::string_view get_machine_type(Context<E> &ctx, MappedFile<Context<E>> *mf);
 template <typename E>
 MappedFile<Context<E>> *open_library(Context<E> &ctx, std::string path);
 
+template <typename E>
+MappedFile<Context<E>> *
+open_library(Context<E> &ctx, std::string_view dir, std::string_view name);
+
 template <typename E>
 MappedFile<Context<E>> *find_library(Context<E> &ctx, std::string path);
 
@@ -1931,6 +2073,12 @@ public:
   Symbol(std::string_view name) : nameptr(name.data()), namelen(name.size()) {}
   Symbol(const Symbol<E> &other) : Symbol(other.name()) {}
 
+  // Global symbols are allocated one by one by get_symbol(). We use the
+  // arena so that symbols created while parsing the same file are
+  // adjacent in memory.
+  static void *operator new(size_t size) { return arena_alloc(size); }
+  static void operator delete(void *) {}
+
   u64 get_addr(Context<E> &ctx, i64 flags = 0) const;
   u64 get_got_addr(Context<E> &ctx) const;
   u64 get_gotplt_addr(Context<E> &ctx) const;
@@ -2016,9 +2164,6 @@ public:
   // to yield an address.
   u64 value = 0;
 
-  const char *nameptr = nullptr;
-  i32 namelen = 0;
-
   // Index into the symbol table of the owner file.
   i32 sym_idx = -1;
 
@@ -2144,6 +2289,12 @@ public:
   // opposed to IR object).
   bool referenced_by_regular_obj : 1 = false;
 
+  // Members above are accessed by hot loops such as scan_relocations().
+  // Symbol names are needed mostly for symbol resolution and for error
+  // messages, so they are placed last.
+  const char *nameptr = nullptr;
+  i32 namelen = 0;
+
   // Target-dependent extra members.
   [[no_unique_address]] SymbolExtras<E> extra;
 };
@@ -2154,9 +2305,18 @@ public:
 template <typename E>
 Symbol<E> *get_symbol(Context<E> &ctx, std::string_view key,
                       std::string_view name) {
-  typename decltype(ctx.symbol_map)::const_accessor acc;
-  ctx.symbol_map.insert(acc, {key, Symbol<E>(name)});
-  return const_cast<Symbol<E> *>(&acc->second);
+  // Most lookups are for existing symbols, so we first try to find
+  // one with a shared lock.
+  {
+    typename decltype(ctx.symbol_map)::const_accessor acc;
+    if (ctx.symbol_map.find(acc, key))
+      return acc->second;
+  }
+
+  typename decltype(ctx.symbol_map)::accessor acc;
+  if (ctx.symbol_map.insert(acc, key))
+    acc->second = new Symbol<E>(name);
+  return acc->second;
 }
 
 template <typename E>
@@ -2263,6 +2423,8 @@ template <typename E>
 inline std::span<ElfRel<E>> InputSection<E>::get_rels(Context<E> &ctx) const {
   if (relsec_idx == -1)
     return {};
+  if (file.elf_sections[relsec_idx].sh_type == SHT_CREL)
+    return file.get_crels(ctx, relsec_idx);
   return file.template get_data<ElfRel<E>>(ctx, file.elf_sections[relsec_idx]);
 }
 
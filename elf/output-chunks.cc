@@ -437,16 +437,29 @@ void RelDynSection<E>::update_shdr(Context<E> &ctx) {
     offset += file->num_dynrel * sizeof(ElfRel<E>);
   }
 
-  this->shdr.sh_size = offset;
   this->shdr.sh_link = ctx.dynsym->shndx;
+
+  // If --pack-dyn-relocs=android is given, relocations are written to
+  // a separate buffer and encoded later. See set_android_reldyn_size()
+  // for how the size of the packed table is determined.
+  if (ctx.arg.pack_dyn_relocs_android && ctx.dynamic && offset) {
+    unpacked_buf.resize(offset);
+    this->shdr.sh_type = E::is_rela ? SHT_ANDROID_RELA : SHT_ANDROID_REL;
+    this->shdr.sh_entsize = 1;
+    this->shdr.sh_size = (android_size == -1) ? offset : android_size;
+  } else {
+    this->shdr.sh_size = offset;
+  }
 }
 
 template <typename E>
 void RelDynSection<E>::sort(Context<E> &ctx) {
   Timer t(ctx, "sort_dynamic_relocs");
 
-  ElfRel<E> *begin = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset);
-  ElfRel<E> *end = (ElfRel<E> *)((u8 *)begin + this->shdr.sh_size);
+  i64 size =
+    unpacked_buf.empty() ? (i64)this->shdr.sh_size : unpacked_buf.size();
+  ElfRel<E> *begin = (ElfRel<E> *)get_buf(ctx);
+  ElfRel<E> *end = (ElfRel<E> *)((u8 *)begin + size);
 
   auto get_rank = [](u32 r_type) {
     if (r_type == E::R_RELATIVE)
@@ -482,6 +495,174 @@ void RelDynSection<E>::sort(Context<E> &ctx) {
   });
 }
 
+// Encode relocations in [begin, end) in the Android packed relocation
+// format (APS2). Relocations are encoded as a sequence of groups. Each
+// group starts with its size and flags, followed by fields shared by all
+// relocations in the group, followed by the rest of the fields of each
+// relocation. r_offset and r_addend are encoded as deltas from those of
+// the previous relocation, and all values are encoded in SLEB128.
+//
+// A decoder's state at the beginning of a group depends only on the
+// preceding relocation, so slices of a relocation table can be encoded
+// independently and concatenated later.
+template <typename E>
+static std::vector<u8> encode_android_relocs(ElfRel<E> *rels, i64 begin,
+                                             i64 end) {
+  enum {
+    GROUPED_BY_INFO = 1,
+    GROUPED_BY_OFFSET_DELTA = 2,
+    GROUPED_BY_ADDEND = 4,
+    GROUP_HAS_ADDEND = 8,
+  };
+
+  // We create a group of relocations with the same r_offset delta only if
+  // it contains at least this number of relocations.
+  static constexpr i64 MIN_STRIDED = 4;
+
+  std::vector<u8> buf;
+
+  // Values are sign-extended to the target word size by the decoder.
+  auto write = [&](u64 val) {
+    if constexpr (E::is_64)
+      encode_sleb(buf, (i64)val);
+    else
+      encode_sleb(buf, (i32)val);
+  };
+
+  // r_info is a single word whose layout varies across targets.
+  auto get_info = [&](i64 i) -> u64 {
+    return *(Word<E> *)((u8 *)(rels + i) + sizeof(Word<E>));
+  };
+
+  auto get_offset_delta = [&](i64 i) -> u64 {
+    return rels[i].r_offset - (i ? (u64)rels[i - 1].r_offset : 0);
+  };
+
+  auto get_r_addend = [&](i64 i) -> i64 {
+    if constexpr (E::is_rela)
+      return rels[i].r_addend;
+    return 0;
+  };
+
+  auto get_addend_delta = [&](i64 i) -> u64 {
+    return get_r_addend(i) - (i ? get_r_addend(i - 1) : 0);
+  };
+
+  // Returns the number of relocations starting from `i` that share the
+  // same r_info and the same r_offset delta, up to `limit`.
+  auto count_strided = [&](i64 i, i64 limit) {
+    i64 j = i + 1;
+    while (j < end && j - i < limit && get_info(j) == get_info(i) &&
+           get_offset_delta(j) == get_offset_delta(i))
+      j++;
+    return j - i;
+  };
+
+  auto starts_info_group = [&](i64 i) {
+    return i + 1 < end && get_info(i) == get_info(i + 1);
+  };
+
+  for (i64 i = begin; i < end;) {
+    i64 j = i + 1;
+    i64 flags = 0;
+
+    if (count_strided(i, MIN_STRIDED) == MIN_STRIDED) {
+      j = i + count_strided(i, end - i);
+      flags = GROUPED_BY_INFO | GROUPED_BY_OFFSET_DELTA;
+    } else if (starts_info_group(i)) {
+      while (j < end && get_info(j) == get_info(i) &&
+             count_strided(j, MIN_STRIDED) < MIN_STRIDED)
+        j++;
+      flags = GROUPED_BY_INFO;
+    } else {
+      while (j < end && !starts_info_group(j) &&
+             count_strided(j, MIN_STRIDED) < MIN_STRIDED)
+        j++;
+    }
+
+    // If all relocations in a group have the same addend, we write it
+    // only once. A group without GROUP_HAS_ADDEND implies zero addends.
+    if constexpr (E::is_rela) {
+      bool same_addend = true;
+      for (i64 k = i + 1; k < j && same_addend; k++)
+        same_addend = (get_r_addend(k) == get_r_addend(i));
+
+      if (!same_addend)
+        flags |= GROUP_HAS_ADDEND;
+      else if (get_r_addend(i))
+        flags |= GROUP_HAS_ADDEND | GROUPED_BY_ADDEND;
+    }
+
+    write(j - i);
+    write(flags);
+
+    if (flags & GROUPED_BY_OFFSET_DELTA)
+      write(get_offset_delta(i));
+    if (flags & GROUPED_BY_INFO)
+      write(get_info(i));
+    if (flags & GROUPED_BY_ADDEND)
+      write(get_addend_delta(i));
+
+    for (i64 k = i; k < j; k++) {
+      if (!(flags & GROUPED_BY_OFFSET_DELTA))
+        write(get_offset_delta(k));
+      if (!(flags & GROUPED_BY_INFO))
+        write(get_info(k));
+      if ((flags & GROUP_HAS_ADDEND) && !(flags & GROUPED_BY_ADDEND))
+        write(get_addend_delta(k));
+    }
+
+    i = j;
+  }
+  return buf;
+}
+
+// Encodes relocations in the Android packed relocation format. They
+// must have been sorted by sort().
+template <typename E>
+std::vector<u8> RelDynSection<E>::encode_android(Context<E> &ctx) {
+  ElfRel<E> *rels = (ElfRel<E> *)unpacked_buf.data();
+  i64 num_rels = unpacked_buf.size() / sizeof(ElfRel<E>);
+
+  constexpr i64 slice_size = 1 << 16;
+  i64 num_slices = align_to(num_rels, slice_size) / slice_size;
+  std::vector<std::vector<u8>> slices(num_slices);
+
+  tbb::parallel_for((i64)0, num_slices, [&](i64 i) {
+    i64 begin = i * slice_size;
+    i64 end = std::min(begin + slice_size, num_rels);
+    slices[i] = encode_android_relocs(rels, begin, end);
+  });
+
+  // The header consists of a magic, the number of relocations and
+  // the initial r_offset.
+  std::vector<u8> buf = {'A', 'P', 'S', '2'};
+  encode_sleb(buf, num_rels);
+  encode_sleb(buf, 0);
+  for (std::vector<u8> &slice : slices)
+    append(buf, slice);
+  return buf;
+}
+
+// Writes the packed relocations to the output file. The memory layout
+// is the same as the one set_android_reldyn_size() computed the size
+// with, so the packed table fits in the reserved space. The rest is
+// zero-filled; the loader stops reading after the last relocation.
+template <typename E>
+void RelDynSection<E>::pack_android(Context<E> &ctx) {
+  Timer t(ctx, "pack_android_relocs");
+
+  std::vector<u8> buf = encode_android(ctx);
+  assert(buf.size() <= this->shdr.sh_size);
+
+  u8 *loc = ctx.buf + this->shdr.sh_offset;
+  write_vector(loc, buf);
+  memset(loc + buf.size(), 0, this->shdr.sh_size - buf.size());
+
+  static Counter counter("android_packed_relocs_bytes_saved");
+  counter += unpacked_buf.size() - this->shdr.sh_size;
+}
+
 template <typename E>
 void RelrDynSection<E>::update_shdr(Context<E> &ctx) {
   this->shdr.sh_link = ctx.dynsym->shndx;
@@ -690,7 +871,13 @@ static std::vector<Word<E>> create_dynamic_section(Context<E> &ctx) {
   for (std::string_view str : ctx.arg.filter)
     define(DT_FILTER, ctx.dynstr->find_string(str));
 
-  if (ctx.reldyn->shdr.sh_size) {
+  if (ctx.reldyn->shdr.sh_type == SHT_ANDROID_REL ||
+      ctx.reldyn->shdr.sh_type == SHT_ANDROID_RELA) {
+    define(E::is_rela ? DT_ANDROID_RELA : DT_ANDROID_REL,
+           ctx.reldyn->shdr.sh_addr);
+    define(E::is_rela ? DT_ANDROID_RELASZ : DT_ANDROID_RELSZ,
+           ctx.reldyn->shdr.sh_size);
+  } else if (ctx.reldyn->shdr.sh_size) {
     define(E::is_rela ? DT_RELA : DT_REL, ctx.reldyn->shdr.sh_addr);
     define(E::is_rela ? DT_RELASZ : DT_RELSZ, ctx.reldyn->shdr.sh_size);
     define(E::is_rela ? DT_RELAENT : DT_RELENT, sizeof(ElfRel<E>));
@@ -855,37 +1042,49 @@ void DynamicSection<E>::copy_buf(Context<E> &ctx) {
 
 template <typename E>
 void OutputSection<E>::copy_buf(Context<E> &ctx) {
+  // We are writing to the output file itself, so input sections may be
+  // copied to it by the kernel.
   if (this->shdr.sh_type != SHT_NOBITS)
-    write_to(ctx, ctx.buf + this->shdr.sh_offset);
+    write_members(ctx, ctx.buf + this->shdr.sh_offset, ctx.output_file.get());
 }
 
+// Fill gaps between input sections.
 template <typename E>
-void OutputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
-  auto clear = [&](u8 *loc, i64 size) {
-    // As a special case, .init and .fini are filled with NOPs for s390x
-    // because the runtime executes the sections as if they were a single
-    // function. .init and .fini are superceded by .init_array and
-    // .fini_array but being actively used only on s390x.
-    if constexpr (is_s390x<E>) {
-      if (this->name == ".init" || this->name == ".fini") {
-        for (i64 i = 0; i < size; i += 2)
-          *(ub16 *)(loc + i) = 0x0700; // nop
-        return;
-      }
+static void clear_gap(OutputSection<E> &osec, u8 *loc, i64 size) {
+  // As a special case, .init and .fini are filled with NOPs for s390x
+  // because the runtime executes the sections as if they were a single
+  // function. .init and .fini are superceded by .init_array and
+  // .fini_array but being actively used only on s390x.
+  if constexpr (is_s390x<E>) {
+    if (osec.name == ".init" || osec.name == ".fini") {
+      for (i64 i = 0; i < size; i += 2)
+        *(ub16 *)(loc + i) = 0x0700; // nop
+      return;
     }
-    memset(loc, 0, size);
-  };
+  }
+  memset(loc, 0, size);
+}
+
+template <typename E>
+void OutputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
+  write_members(ctx, buf, nullptr);
+}
 
+template <typename E>
+void OutputSection<E>::write_members(Context<E> &ctx, u8 *buf,
+                                     OutputFile<Context<E>> *out) {
   tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
     // Copy section contents to an output file
     InputSection<E> &isec = *members[i];
-    isec.write_to(ctx, buf + isec.offset);
+    isec.write_to(ctx, buf + isec.offset, out);
+    if (!ctx.arg.keep_memory)
+      isec.release_pages();
 
     // Clear trailing padding
     u64 this_end = isec.offset + isec.sh_size;
     u64 next_start = (i == members.size() - 1) ?
       (u64)this->shdr.sh_size : members[i + 1]->offset;
-    clear(buf + this_end, next_start - this_end);
+    clear_gap(*this, buf + this_end, next_start - this_end);
   });
 
   if constexpr (needs_thunk<E>) {
@@ -896,6 +1095,89 @@ void OutputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
   }
 }
 
+// Split this section into pieces of about 1 MiB each so that a large
+// debug section can be compressed in parallel without materializing its
+// entire contents. We split it at input section boundaries if possible,
+// but a large input section such as .debug_info of a big object file is
+// split into 1 MiB pieces, too.
+template <typename E>
+std::vector<i64> OutputSection<E>::get_piece_offsets(Context<E> &ctx) {
+  constexpr i64 piece_size = 1024 * 1024;
+
+  std::vector<i64> vec = {0};
+  for (InputSection<E> *isec : members) {
+    if (vec.back() + piece_size <= isec->offset)
+      vec.push_back(isec->offset);
+    for (i64 i = piece_size; i < isec->sh_size; i += piece_size)
+      vec.push_back(isec->offset + i);
+  }
+  vec.push_back(this->shdr.sh_size);
+
+  // Find input sections spanning more than one piece.
+  split_sections.clear();
+
+  for (InputSection<E> *isec : members) {
+    i64 begin = isec->offset;
+    i64 end = isec->offset + isec->sh_size;
+    i64 n = std::lower_bound(vec.begin(), vec.end(), end) -
+            std::upper_bound(vec.begin(), vec.end(), begin);
+
+    if (n > 0) {
+      SplitSection *sec = new SplitSection;
+      sec->num_pieces = n + 1;
+      split_sections[isec].reset(sec);
+    }
+  }
+  return vec;
+}
+
+template <typename E>
+void OutputSection<E>::write_piece(Context<E> &ctx, u8 *buf, i64 begin,
+                                   i64 end) {
+  // Range extension thunks are written directly to the output file.
+  if constexpr (needs_thunk<E>)
+    assert(thunks.empty());
+
+  auto it = std::partition_point(members.begin(), members.end(),
+                                 [&](InputSection<E> *isec) {
+    return isec->offset + isec->sh_size <= begin;
+  });
+
+  i64 offset = begin;
+  for (; it != members.end() && (*it)->offset < end; it++) {
+    InputSection<E> &isec = **it;
+    i64 isec_end = isec.offset + isec.sh_size;
+
+    if (offset < isec.offset)
+      clear_gap(*this, buf + offset - begin, isec.offset - offset);
+
+    if (begin <= isec.offset && isec_end <= end) {
+      isec.write_to(ctx, buf + isec.offset - begin);
+      if (!ctx.arg.keep_memory)
+        isec.release_pages();
+      offset = isec_end;
+      continue;
+    }
+
+    SplitSection &sec = *split_sections.find(&isec)->second;
+    std::call_once(sec.once, [&] {
+      sec.buf.reset(new u8[isec.sh_size]);
+      isec.write_to(ctx, sec.buf.get());
+      if (!ctx.arg.keep_memory)
+        isec.release_pages();
+    });
+
+    i64 lo = std::max<i64>(begin, isec.offset);
+    i64 hi = std::min<i64>(end, isec_end);
+    memcpy(buf + lo - begin, sec.buf.get() + lo - isec.offset, hi - lo);
+    offset = hi;
+
+    if (--sec.num_pieces == 0)
+      sec.buf.reset();
+  }
+  clear_gap(*this, buf + offset - begin, end - offset);
+}
+
 // .relr.dyn contains base relocations encoded in a space-efficient form.
 // The contents of the section is essentially just a list of addresses
 // that have to be fixed up at runtime.
@@ -1237,7 +1519,12 @@ i64 GotSection<E>::get_reldyn_size(Context<E> &ctx) const {
 // Fill .got and .rel.dyn.
 template <typename E>
 void GotSection<E>::copy_buf(Context<E> &ctx) {
-  Word<E> *buf = (Word<E> *)(ctx.buf + this->shdr.sh_offset);
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+template <typename E>
+void GotSection<E>::write_to(Context<E> &ctx, u8 *loc) {
+  Word<E> *buf = (Word<E> *)loc;
   memset(buf, 0, this->shdr.sh_size);
 
   // s390x psABI requires GOT[0] to be set to the link-time value of _DYNAMIC.
@@ -1253,7 +1540,7 @@ void GotSection<E>::copy_buf(Context<E> &ctx) {
     if (ctx.dynamic && ctx.arg.is_static && ctx.arg.pie)
       buf[0] = ctx.dynamic->shdr.sh_addr;
 
-  ElfRel<E> *rel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+  ElfRel<E> *rel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                                  this->reldyn_offset);
 
   for (GotEntry<E> &ent : get_got_entries(ctx)) {
@@ -1893,6 +2180,86 @@ MergedSection<E>::insert(Context<E> &ctx, std::string_view data, u64 hash,
   return frag;
 }
 
+// Returns true if `a` is less than `b` when both strings are read
+// backwards.
+static bool reverse_less(std::string_view a, std::string_view b) {
+  i64 len = std::min(a.size(), b.size());
+  for (i64 i = 1; i <= len; i++)
+    if (a[a.size() - i] != b[b.size() - i])
+      return (u8)a[a.size() - i] < (u8)b[b.size() - i];
+  return a.size() < b.size();
+}
+
+// Tail merging is an optimization to place a string in the middle of
+// another string if the former is a suffix of the latter. For example,
+// "bar\0" can share the last four bytes of "foobar\0", so we don't need
+// to emit "bar\0" at all.
+//
+// To find such pairs, we sort all strings in the descending order of
+// their reversed contents. Then, if a string is a suffix of another
+// string, the former immediately follows the latter or another string
+// that has the same suffix. So we only need to compare neighbors.
+//
+// The section contents remain deterministic because the sort order is
+// a total order of distinct strings.
+template <typename E>
+std::vector<typename MergedSection<E>::TailMergedFragment>
+MergedSection<E>::tail_merge(Context<E> &ctx) {
+  Timer t(ctx, "tail_merge " + std::string(this->name));
+
+  struct KeyVal {
+    std::string_view key;
+    SectionFragment<E> *val;
+  };
+
+  i64 shard_size = map.nbuckets / map.NUM_SHARDS;
+  std::vector<std::vector<KeyVal>> shards(map.NUM_SHARDS);
+
+  tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
+    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
+      if (const char *key = map.get_key(j))
+        if (SectionFragment<E> &frag = map.values[j]; frag.is_alive)
+          shards[i].push_back({{key, map.key_sizes[j]}, &frag});
+  });
+
+  std::vector<KeyVal> strings = flatten(shards);
+
+  tbb::parallel_sort(strings.begin(), strings.end(),
+                     [](const KeyVal &a, const KeyVal &b) {
+    return reverse_less(b.key, a.key);
+  });
+
+  // For each string, `leaders[i]` and `deltas[i]` are the string that
+  // is actually written to the output and the offset within it.
+  std::vector<SectionFragment<E> *> leaders(strings.size());
+  std::vector<u32> deltas(strings.size());
+  std::vector<TailMergedFragment> vec;
+
+  for (i64 i = 0; i < strings.size(); i++) {
+    leaders[i] = strings[i].val;
+
+    if (i == 0 || !strings[i - 1].key.ends_with(strings[i].key))
+      continue;
+
+    SectionFragment<E> &frag = *strings[i].val;
+    SectionFragment<E> *leader = leaders[i - 1];
+    i64 delta = deltas[i - 1] + strings[i - 1].key.size() - strings[i].key.size();
+
+    // The suffix has to satisfy its own alignment requirement.
+    if (leader->p2align < frag.p2align || delta % (1 << frag.p2align))
+      continue;
+
+    leaders[i] = leader;
+    deltas[i] = delta;
+    frag.is_tail_merged = true;
+    vec.push_back({&frag, leader, (u32)delta});
+  }
+
+  static Counter counter("tail_merged_strings");
+  counter += vec.size();
+  return vec;
+}
+
 template <typename E>
 void MergedSection<E>::assign_offsets(Context<E> &ctx) {
   std::vector<i64> sizes(map.NUM_SHARDS);
@@ -1901,6 +2268,11 @@ void MergedSection<E>::assign_offsets(Context<E> &ctx) {
 
   i64 shard_size = map.nbuckets / map.NUM_SHARDS;
 
+  // Tail merging is enabled only for string sections with -O2.
+  std::vector<TailMergedFragment> tail_merged;
+  if (ctx.arg.optimize >= 2 && (this->shdr.sh_flags & SHF_STRINGS))
+    tail_merged = tail_merge(ctx);
+
   tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
     struct KeyVal {
       std::string_view key;
@@ -1912,7 +2284,8 @@ void MergedSection<E>::assign_offsets(Context<E> &ctx) {
 
     for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
       if (const char *key = map.get_key(j))
-        if (SectionFragment<E> &frag = map.values[j]; frag.is_alive)
+        if (SectionFragment<E> &frag = map.values[j];
+            frag.is_alive && !frag.is_tail_merged)
           fragments.push_back({{key, map.key_sizes[j]}, &frag});
 
     // Sort fragments to make output deterministic.
@@ -1951,10 +2324,15 @@ void MergedSection<E>::assign_offsets(Context<E> &ctx) {
 
   tbb::parallel_for((i64)1, map.NUM_SHARDS, [&](i64 i) {
     for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
-      if (SectionFragment<E> &frag = map.values[j]; frag.is_alive)
+      if (SectionFragment<E> &frag = map.values[j];
+          frag.is_alive && !frag.is_tail_merged)
         frag.offset += shard_offsets[i];
   });
 
+  tbb::parallel_for_each(tail_merged, [](TailMergedFragment &x) {
+    x.frag->offset = x.leader->offset + x.delta;
+  });
+
   this->shdr.sh_size = shard_offsets[map.NUM_SHARDS];
   this->shdr.sh_addralign = 1 << p2align;
 }
@@ -1973,11 +2351,78 @@ void MergedSection<E>::write_to(Context<E> &ctx, u8 *buf) {
 
     for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
       if (const char *key = map.get_key(j))
-        if (SectionFragment<E> &frag = map.values[j]; frag.is_alive)
+        if (SectionFragment<E> &frag = map.values[j];
+            frag.is_alive && !frag.is_tail_merged)
           memcpy(buf + frag.offset, key, map.key_sizes[j]);
   });
 }
 
+// Each hash map shard is laid out contiguously. We split each shard
+// further into pieces of about 1 MiB at fragment boundaries so that a
+// large string section such as .debug_str can be compressed in parallel
+// without materializing an entire shard at once.
+template <typename E>
+std::vector<i64> MergedSection<E>::get_piece_offsets(Context<E> &ctx) {
+  constexpr i64 piece_size = 1024 * 1024;
+  i64 shard_size = map.nbuckets / map.NUM_SHARDS;
+  std::vector<std::vector<i64>> boundaries(map.NUM_SHARDS);
+
+  tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
+    if (shard_offsets[i + 1] - shard_offsets[i] <= piece_size)
+      return;
+
+    std::vector<i64> offsets;
+    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
+      if (map.get_key(j))
+        if (SectionFragment<E> &frag = map.values[j];
+            frag.is_alive && !frag.is_tail_merged)
+          offsets.push_back(frag.offset);
+    sort(offsets);
+
+    i64 last = shard_offsets[i];
+    for (i64 off : offsets) {
+      if (last + piece_size <= off) {
+        boundaries[i].push_back(off);
+        last = off;
+      }
+    }
+  });
+
+  std::vector<i64> vec;
+  for (i64 i = 0; i < map.NUM_SHARDS; i++) {
+    vec.push_back(shard_offsets[i]);
+    append(vec, boundaries[i]);
+  }
+  vec.push_back(shard_offsets[map.NUM_SHARDS]);
+  vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
+  return vec;
+}
+
+// Since piece boundaries are at fragment starts, a fragment whose
+// offset is in [begin, end) is entirely contained in the piece.
+template <typename E>
+void MergedSection<E>::write_piece(Context<E> &ctx, u8 *buf, i64 begin,
+                                   i64 end) {
+  i64 shard_size = map.nbuckets / map.NUM_SHARDS;
+  memset(buf, 0, end - begin);
+
+  for (i64 i = 0; i < map.NUM_SHARDS; i++) {
+    if (end <= shard_offsets[i] || shard_offsets[i + 1] <= begin)
+      continue;
+
+    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++) {
+      if (const char *key = map.get_key(j)) {
+        SectionFragment<E> &frag = map.values[j];
+        if (frag.is_alive && !frag.is_tail_merged &&
+            begin <= frag.offset && frag.offset < end) {
+          assert(frag.offset + map.key_sizes[j] <= end);
+          memcpy(buf + frag.offset - begin, key, map.key_sizes[j]);
+        }
+      }
+    }
+  }
+}
+
 template <typename E>
 void MergedSection<E>::print_stats(Context<E> &ctx) {
   i64 used = 0;
@@ -2271,10 +2716,15 @@ void CopyrelSection<E>::update_shdr(Context<E> &ctx) {
 
 template <typename E>
 void CopyrelSection<E>::copy_buf(Context<E> &ctx) {
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+template <typename E>
+void CopyrelSection<E>::write_to(Context<E> &ctx, u8 *buf) {
   if (this->shdr.sh_type == SHT_PROGBITS)
-    memset(ctx.buf + this->shdr.sh_offset, 0, this->shdr.sh_size);
+    memset(buf, 0, this->shdr.sh_size);
 
-  ElfRel<E> *rel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
+  ElfRel<E> *rel = (ElfRel<E> *)(ctx.reldyn->get_buf(ctx) +
                                  this->reldyn_offset);
 
   for (Symbol<E> *sym : symbols)
@@ -2941,38 +3391,62 @@ void GdbIndexSection<E>::write_address_areas(Context<E> &ctx) {
 }
 
 template <typename E>
-CompressedSection<E>::CompressedSection(Context<E> &ctx, Chunk<E> &chunk) {
+CompressedSection<E>::CompressedSection(Context<E> &ctx, Chunk<E> &chunk)
+  : chunk(chunk) {
   assert(chunk.name.starts_with(".debug"));
   this->name = chunk.name;
 
-  uncompressed.reset(new u8[chunk.shdr.sh_size]);
-  chunk.write_to(ctx, uncompressed.get());
-
-  switch (ctx.arg.compress_debug_sections) {
-  case COMPRESS_ZLIB:
-    chdr.ch_type = ELFCOMPRESS_ZLIB;
-    compressed.reset(new ZlibCompressor(uncompressed.get(), chunk.shdr.sh_size));
-    break;
-  case COMPRESS_ZSTD:
-    chdr.ch_type = ELFCOMPRESS_ZSTD;
-    compressed.reset(new ZstdCompressor(uncompressed.get(), chunk.shdr.sh_size));
-    break;
-  default:
-    unreachable();
-  }
-
+  bool is_zlib = (ctx.arg.compress_debug_sections == COMPRESS_ZLIB);
+  chdr.ch_type = is_zlib ? ELFCOMPRESS_ZLIB : ELFCOMPRESS_ZSTD;
   chdr.ch_size = chunk.shdr.sh_size;
   chdr.ch_addralign = chunk.shdr.sh_addralign;
 
+  // The section size is unknown until compress() is called.
   this->shdr = chunk.shdr;
   this->shdr.sh_flags |= SHF_COMPRESSED;
   this->shdr.sh_addralign = 1;
-  this->shdr.sh_size = sizeof(chdr) + compressed->compressed_size;
+  this->shdr.sh_size = 0;
   this->shndx = chunk.shndx;
+}
+
+template <typename E>
+void CompressedSection<E>::compress(Context<E> &ctx) {
+  bool is_zlib = (chdr.ch_type == ELFCOMPRESS_ZLIB);
+
+  if (ctx.arg.gdb_index) {
+    // --gdb-index needs uncompressed debug sections, so we keep them.
+    u8 *buf = new u8[chunk.shdr.sh_size];
+    uncompressed.reset(buf);
+    chunk.write_to(ctx, buf);
+
+    if (is_zlib)
+      compressed.reset(new ZlibCompressor(buf, chunk.shdr.sh_size));
+    else
+      compressed.reset(new ZstdCompressor(buf, chunk.shdr.sh_size));
+    return;
+  }
+
+  // Otherwise, we write the chunk piece by piece and compress each
+  // piece as soon as it is written, so that we never have the entire
+  // uncompressed contents in memory.
+  std::vector<i64> offsets = chunk.get_piece_offsets(ctx);
 
-  // We don't need to keep the original data unless --gdb-index is given.
-  if (!ctx.arg.gdb_index)
-    uncompressed.reset(nullptr);
+  ShardReader read = [&](i64 i, std::vector<u8> &buf) {
+    buf.resize(offsets[i + 1] - offsets[i]);
+    chunk.write_piece(ctx, buf.data(), offsets[i], offsets[i + 1]);
+    return std::string_view((char *)buf.data(), buf.size());
+  };
+
+  if (is_zlib)
+    compressed.reset(new ZlibCompressor(offsets.size() - 1, read));
+  else
+    compressed.reset(new ZstdCompressor(offsets.size() - 1, read));
+}
+
+template <typename E>
+void CompressedSection<E>::update_shdr(Context<E> &ctx) {
+  if (compressed)
+    this->shdr.sh_size = sizeof(chdr) + compressed->compressed_size;
 }
 
 template <typename E>
@@ -2985,7 +3459,10 @@ void CompressedSection<E>::copy_buf(Context<E> &ctx) {
 template <typename E>
 RelocSection<E>::RelocSection(Context<E> &ctx, OutputSection<E> &osec)
   : output_section(osec) {
-  if constexpr (E::is_rela) {
+  if (ctx.arg.z_crel) {
+    this->name = save_string(ctx, ".crel" + std::string(osec.name));
+    this->shdr.sh_type = SHT_CREL;
+  } else if constexpr (E::is_rela) {
     this->name = save_string(ctx, ".rela" + std::string(osec.name));
     this->shdr.sh_type = SHT_RELA;
   } else {
@@ -2994,8 +3471,14 @@ RelocSection<E>::RelocSection(Context<E> &ctx, OutputSection<E> &osec)
   }
 
   this->shdr.sh_flags = SHF_INFO_LINK;
-  this->shdr.sh_addralign = sizeof(Word<E>);
-  this->shdr.sh_entsize = sizeof(ElfRel<E>);
+
+  if (ctx.arg.z_crel) {
+    this->shdr.sh_addralign = 1;
+    this->shdr.sh_entsize = 1;
+  } else {
+    this->shdr.sh_addralign = sizeof(Word<E>);
+    this->shdr.sh_entsize = sizeof(ElfRel<E>);
+  }
 
   // Compute an offset for each input section
   offsets.resize(osec.members.size());
@@ -3013,6 +3496,8 @@ RelocSection<E>::RelocSection(Context<E> &ctx, OutputSection<E> &osec)
   i64 num_entries = tbb::parallel_scan(
     tbb::blocked_range<i64>(0, osec.members.size()), 0, scan, std::plus());
 
+  // If -z crel is given, this is an upper bound until construct_crel()
+  // computes the actual size.
   this->shdr.sh_size = num_entries * sizeof(ElfRel<E>);
 }
 
@@ -3022,58 +3507,180 @@ void RelocSection<E>::update_shdr(Context<E> &ctx) {
   this->shdr.sh_info = output_section.shndx;
 }
 
+// Returns an output relocation for a given input relocation along with
+// its addend. The addend is also needed for REL-type targets, as we
+// write it to the relocated place for --relocatable.
 template <typename E>
-void RelocSection<E>::copy_buf(Context<E> &ctx) {
-  auto write = [&](ElfRel<E> &out, InputSection<E> &isec, const ElfRel<E> &rel) {
-    i64 symidx = 0;
-    i64 addend = 0;
+static std::pair<ElfRel<E>, i64>
+get_output_reloc(Context<E> &ctx, InputSection<E> &isec, const ElfRel<E> &rel) {
+  i64 symidx = 0;
+  i64 addend = 0;
 
-    Symbol<E> &sym = *isec.file.symbols[rel.r_sym];
+  Symbol<E> &sym = *isec.file.symbols[rel.r_sym];
 
-    if (sym.esym().st_type == STT_SECTION) {
-      if (SectionFragment<E> *frag = sym.get_frag()) {
-        symidx = frag->output_section.shndx;
-        addend = frag->offset + sym.value + get_addend(isec, rel);
+  if (sym.esym().st_type == STT_SECTION) {
+    if (SectionFragment<E> *frag = sym.get_frag()) {
+      symidx = frag->output_section.shndx;
+      addend = frag->offset + sym.value + get_addend(isec, rel);
+    } else {
+      InputSection<E> *target = sym.get_input_section();
+
+      if (OutputSection<E> *osec = target->output_section) {
+        symidx = osec->shndx;
+        addend = get_addend(isec, rel) + target->offset;
+      } else if (isec.name() == ".eh_frame") {
+        symidx = ctx.eh_frame->shndx;
+        addend = get_addend(isec, rel);
       } else {
-        InputSection<E> *target = sym.get_input_section();
-
-        if (OutputSection<E> *osec = target->output_section) {
-          symidx = osec->shndx;
-          addend = get_addend(isec, rel) + target->offset;
-        } else if (isec.name() == ".eh_frame") {
-          symidx = ctx.eh_frame->shndx;
-          addend = get_addend(isec, rel);
-        } else {
-          // This is usually a dead debug section referring a
-          // COMDAT-eliminated section.
-        }
+        // This is usually a dead debug section referring a
+        // COMDAT-eliminated section.
       }
-    } else {
-      if (sym.sym_idx)
-        symidx = sym.get_output_sym_idx(ctx);
-      addend = get_addend(isec, rel);
     }
+  } else {
+    if (sym.sym_idx)
+      symidx = sym.get_output_sym_idx(ctx);
+    addend = get_addend(isec, rel);
+  }
 
-    if constexpr (is_alpha<E>)
-      if (rel.r_type == R_ALPHA_GPDISP || rel.r_type == R_ALPHA_LITUSE)
-        addend = rel.r_addend;
+  if constexpr (is_alpha<E>)
+    if (rel.r_type == R_ALPHA_GPDISP || rel.r_type == R_ALPHA_LITUSE)
+      addend = rel.r_addend;
 
-    i64 r_offset = isec.output_section->shdr.sh_addr + isec.offset + rel.r_offset;
-    out = ElfRel<E>(r_offset, rel.r_type, symidx, addend);
+  i64 r_offset = isec.output_section->shdr.sh_addr + isec.offset + rel.r_offset;
+  return {ElfRel<E>(r_offset, rel.r_type, symidx, addend), addend};
+}
 
-    if (ctx.arg.relocatable) {
-      u8 *base = ctx.buf + isec.output_section->shdr.sh_offset + isec.offset;
-      write_addend(base + rel.r_offset, addend, rel);
-    }
+// Encode relocations in [begin, end) in the CREL format. See
+// ObjectFile::decode_crel for the format. Each field is encoded as a
+// delta from the previous relocation, so slices of a relocation table
+// can be encoded independently and concatenated later.
+template <typename E>
+static std::vector<u8> encode_crel(std::span<ElfRel<E>> rels, i64 begin,
+                                   i64 end, i64 shift) {
+  using UWord = std::conditional_t<E::is_64, u64, u32>;
+  constexpr i64 flag_bits = E::is_rela ? 3 : 2;
+
+  std::vector<u8> buf;
+
+  UWord offset = 0;
+  UWord addend = 0;
+  u32 sym = 0;
+  u32 type = 0;
+
+  auto get_addend = [](const ElfRel<E> &rel) -> UWord {
+    if constexpr (E::is_rela)
+      return rel.r_addend;
+    return 0;
   };
 
+  if (begin > 0) {
+    const ElfRel<E> &prev = rels[begin - 1];
+    offset = prev.r_offset;
+    addend = get_addend(prev);
+    sym = prev.r_sym;
+    type = prev.r_type;
+  }
+
+  for (i64 i = begin; i < end; i++) {
+    const ElfRel<E> &rel = rels[i];
+    UWord delta = (UWord)(rel.r_offset - offset) >> shift;
+
+    u8 byte = (delta << flag_bits) | (sym != rel.r_sym) |
+              ((type != rel.r_type) << 1) |
+              ((get_addend(rel) != addend) << 2);
+
+    if (delta < (0x80 >> flag_bits)) {
+      buf.push_back(byte);
+    } else {
+      buf.push_back(byte | 0x80);
+      encode_uleb(buf, delta >> (7 - flag_bits));
+    }
+
+    if (sym != rel.r_sym)
+      encode_sleb(buf, (i32)(rel.r_sym - sym));
+    if (type != rel.r_type)
+      encode_sleb(buf, (i32)(rel.r_type - type));
+    if (get_addend(rel) != addend)
+      encode_sleb(buf, (std::make_signed_t<UWord>)(get_addend(rel) - addend));
+
+    offset = rel.r_offset;
+    addend = get_addend(rel);
+    sym = rel.r_sym;
+    type = rel.r_type;
+  }
+  return buf;
+}
+
+template <typename E>
+void RelocSection<E>::construct_crel(Context<E> &ctx) {
+  i64 num_entries = 0;
+  if (!offsets.empty())
+    num_entries = offsets.back() +
+                  output_section.members.back()->get_rels(ctx).size();
+
+  std::vector<ElfRel<E>> rels(num_entries);
+
+  tbb::parallel_for((i64)0, (i64)output_section.members.size(), [&](i64 i) {
+    InputSection<E> &isec = *output_section.members[i];
+    std::span<const ElfRel<E>> span = isec.get_rels(ctx);
+    for (i64 j = 0; j < span.size(); j++)
+      rels[offsets[i] + j] = get_output_reloc(ctx, isec, span[j]).first;
+  });
+
+  // All r_offsets are stored in the shifted form, so the shift amount
+  // is determined by the least aligned one.
+  u64 mask = 8;
+  for (ElfRel<E> &rel : rels)
+    mask |= rel.r_offset;
+  i64 shift = std::countr_zero(mask);
+
+  constexpr i64 slice_size = 1 << 16;
+  i64 num_slices = align_to(rels.size(), slice_size) / slice_size;
+  std::vector<std::vector<u8>> slices(num_slices);
+
+  tbb::parallel_for((i64)0, num_slices, [&](i64 i) {
+    i64 begin = i * slice_size;
+    i64 end = std::min<i64>(begin + slice_size, rels.size());
+    slices[i] = encode_crel<E>(rels, begin, end, shift);
+  });
+
+  crel.clear();
+  encode_uleb(crel, rels.size() * 8 + (E::is_rela ? CREL_HDR_ADDEND : 0) +
+              shift);
+  for (std::vector<u8> &slice : slices)
+    append(crel, slice);
+
+  this->shdr.sh_size = crel.size();
+}
+
+template <typename E>
+void RelocSection<E>::copy_buf(Context<E> &ctx) {
+  bool is_crel = (this->shdr.sh_type == SHT_CREL);
+
+  if (is_crel) {
+    write_vector(ctx.buf + this->shdr.sh_offset, crel);
+
+    // We still need to write addends to relocated places if the target
+    // uses REL-type relocations and --relocatable is given.
+    if (E::is_rela || !ctx.arg.relocatable)
+      return;
+  }
+
   tbb::parallel_for((i64)0, (i64)output_section.members.size(), [&](i64 i) {
     ElfRel<E> *buf = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset) + offsets[i];
     InputSection<E> &isec = *output_section.members[i];
     std::span<const ElfRel<E>> rels = isec.get_rels(ctx);
 
-    for (i64 j = 0; j < rels.size(); j++)
-      write(buf[j], isec, rels[j]);
+    for (i64 j = 0; j < rels.size(); j++) {
+      auto [out, addend] = get_output_reloc(ctx, isec, rels[j]);
+      if (!is_crel)
+        buf[j] = out;
+
+      if (ctx.arg.relocatable) {
+        u8 *base = ctx.buf + isec.output_section->shdr.sh_offset + isec.offset;
+        write_addend(base + rels[j].r_offset, addend, rels[j]);
+      }
+    }
   });
 }
 
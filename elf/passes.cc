@@ -1451,6 +1451,197 @@ void create_reloc_sections(Context<E> &ctx) {
         ctx.chunks.push_back(x);
 }
 
+// If -z crel is given, relocation sections for --relocatable and
+// --emit-relocs are written in the CREL format. Since the size of a CREL
+// section depends on the relocation values, we can't compute it until
+// the memory layout is fixed. Callers are expected to assign file
+// offsets again after calling this function.
+template <typename E>
+void construct_crel(Context<E> &ctx) {
+  Timer t(ctx, "construct_crel");
+
+  tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
+    if (OutputSection<E> *osec = chunk->to_osec())
+      if (RelocSection<E> *sec = osec->reloc_sec.get())
+        sec->construct_crel(ctx);
+  });
+}
+
+// Wait for the background compression started by compress_debug_sections()
+// and write the compressed sections and the section header at the end of
+// the output file.
+template <typename E>
+static void write_compressed_debug_sections(Context<E> &ctx) {
+  ctx.compress_tg.wait();
+
+  auto it = std::find_if(ctx.chunks.begin(), ctx.chunks.end(),
+                         [](Chunk<E> *chunk) {
+    return chunk->shdr.sh_flags & SHF_COMPRESSED;
+  });
+
+  if (it == ctx.chunks.end())
+    return;
+
+  Timer t(ctx, "write_compressed_debug_sections");
+  std::span<Chunk<E> *> tail(it, ctx.chunks.end());
+  i64 fileoff = (*it)->shdr.sh_offset;
+
+  for (Chunk<E> *chunk : tail) {
+    chunk->update_shdr(ctx);
+    fileoff = align_to(fileoff, chunk->shdr.sh_addralign);
+    chunk->shdr.sh_offset = fileoff;
+    fileoff += chunk->shdr.sh_size;
+  }
+
+  i64 old_size = ctx.output_file->filesize;
+  ctx.output_file->resize(ctx, fileoff);
+  ctx.buf = ctx.output_file->buf;
+
+  if (ctx.arg.filler != -1 && old_size < fileoff)
+    memset(ctx.buf + old_size, ctx.arg.filler, fileoff - old_size);
+
+  tbb::parallel_for_each(tail, [&](Chunk<E> *chunk) {
+    chunk->copy_buf(ctx);
+  });
+
+  // The ELF header contains the file offset of the section header.
+  if (ctx.ehdr)
+    ctx.ehdr->copy_buf(ctx);
+}
+
+// For --memory-limit. Instead of writing all chunks at once, we write
+// them in waves, each of which writes at most as many bytes as the
+// remaining memory budget. Chunks larger than the budget are split into
+// pieces if possible. After each wave, written pages are flushed to the
+// file and dropped from our address space.
+//
+// The budget is recomputed before each wave from the current RSS, but we
+// always make progress by writing at least one piece (1 MiB for a large
+// output section) per wave.
+template <typename E, typename Fn>
+static void copy_in_waves(Context<E> &ctx, std::span<Chunk<E> *> chunks,
+                          Fn copy) {
+  constexpr i64 min_budget = 1024 * 1024;
+
+  auto get_budget = [&] {
+    return std::max(ctx.arg.memory_limit - get_rss(), min_budget);
+  };
+
+  i64 budget = get_budget();
+
+  struct Piece {
+    Chunk<E> *chunk;
+    i64 begin;
+    i64 end;
+    bool is_last;
+  };
+
+  auto can_split = [&](Chunk<E> *chunk) {
+    if constexpr (needs_thunk<E>)
+      if (OutputSection<E> *osec = chunk->to_osec())
+        return osec->thunks.empty();
+    return true;
+  };
+
+  std::vector<Piece> pieces;
+
+  for (Chunk<E> *chunk : chunks) {
+    i64 size = (chunk->shdr.sh_type == SHT_NOBITS) ? 0 : (i64)chunk->shdr.sh_size;
+    std::vector<i64> offsets = {0, size};
+    if (budget < size && can_split(chunk))
+      offsets = chunk->get_piece_offsets(ctx);
+
+    for (i64 i = 0; i < offsets.size() - 1; i++)
+      pieces.push_back({chunk, offsets[i], offsets[i + 1],
+                        i == offsets.size() - 2});
+  }
+
+  auto write = [&](Piece &p) {
+    if (p.begin == 0 && p.is_last)
+      copy(*p.chunk);
+    else
+      p.chunk->write_piece(ctx, ctx.buf + p.chunk->shdr.sh_offset + p.begin,
+                           p.begin, p.end);
+  };
+
+  auto flush = [&](Piece &p) {
+#ifndef _WIN32
+    if (!ctx.output_file->is_mmapped || p.begin == p.end)
+      return;
+
+    static const u64 page_size = sysconf(_SC_PAGESIZE);
+    u8 *begin = ctx.buf + p.chunk->shdr.sh_offset + p.begin;
+    u8 *end = ctx.buf + p.chunk->shdr.sh_offset + p.end;
+    begin = (u8 *)((u64)begin & ~(page_size - 1));
+    end = (u8 *)align_to((u64)end, page_size);
+    end = std::min(end, ctx.buf + ctx.output_file->filesize);
+
+    // Dirty pages can't be reclaimed until they are written back, so
+    // we write them synchronously before unmapping them. After that,
+    // they are clean page cache pages that the kernel can drop at will.
+    msync(begin, end - begin, MS_SYNC);
+    madvise(begin, end - begin, MADV_DONTNEED);
+#endif
+  };
+
+  static Counter num_waves("memory_limit_waves");
+
+  for (i64 i = 0; i < pieces.size();) {
+    budget = get_budget();
+    i64 j = i + 1;
+    i64 size = pieces[i].end - pieces[i].begin;
+    while (j < pieces.size() &&
+           size + pieces[j].end - pieces[j].begin <= budget) {
+      size += pieces[j].end - pieces[j].begin;
+      j++;
+    }
+
+    std::span<Piece> wave(pieces.begin() + i, pieces.begin() + j);
+    tbb::parallel_for_each(wave, write);
+    tbb::parallel_for_each(wave, flush);
+
+    num_waves++;
+    i = j;
+  }
+}
+
+// For --numa. Chunks are split into as many contiguous groups as there
+// are NUMA nodes, and each group is written by the CPUs of one node.
+// Since a page is allocated on the node that first touches it, each node
+// writes to its local memory.
+template <typename E, typename Fn>
+static void copy_on_numa_nodes(Context<E> &ctx, std::span<Chunk<E> *> chunks,
+                               Timer<Context<E>> &t, Fn fn) {
+  auto get_size = [](Chunk<E> *chunk) -> i64 {
+    return (chunk->shdr.sh_type == SHT_NOBITS) ? 0 : (i64)chunk->shdr.sh_size;
+  };
+
+  i64 total = 0;
+  for (Chunk<E> *chunk : chunks)
+    total += get_size(chunk);
+
+  i64 num_nodes = ctx.numa->num_nodes();
+  i64 begin = 0;
+  i64 size = 0;
+
+  for (i64 node = 0; node < num_nodes; node++) {
+    i64 end = begin;
+    while (end < chunks.size() &&
+           (node == num_nodes - 1 || size < total * (node + 1) / num_nodes))
+      size += get_size(chunks[end++]);
+
+    std::span<Chunk<E> *> group = chunks.subspan(begin, end - begin);
+    begin = end;
+
+    ctx.numa->run(node, [=, &ctx, &t] {
+      Timer t2(ctx, "numa_node" + std::to_string(node), &t);
+      tbb::parallel_for_each(group, fn);
+    });
+  }
+
+  ctx.numa->wait();
+}
+
 // Copy chunks to an output file
 template <typename E>
 void copy_chunks(Context<E> &ctx) {
@@ -1462,18 +1653,39 @@ void copy_chunks(Context<E> &ctx) {
     chunk.copy_buf(ctx);
   };
 
+  auto is_reloc = [](Chunk<E> *chunk) {
+    u32 type = chunk->shdr.sh_type;
+    return type == (E::is_rela ? SHT_RELA : SHT_REL) || type == SHT_CREL;
+  };
+
   // For --relocatable and --emit-relocs, we want to copy non-relocation
   // sections first. This is because REL-type relocation sections (as
   // opposed to RELA-type) stores relocation addends to target sections.
-  tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
-    if (chunk->shdr.sh_type != (E::is_rela ? SHT_RELA : SHT_REL))
-      copy(*chunk);
-  });
+  //
+  // Compressed debug sections may still be being compressed in the
+  // background, so they are written last.
+  auto is_deferred = [](Chunk<E> *chunk) {
+    return chunk->shdr.sh_flags & SHF_COMPRESSED;
+  };
 
-  tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
-    if (chunk->shdr.sh_type == (E::is_rela ? SHT_RELA : SHT_REL))
-      copy(*chunk);
-  });
+  std::vector<Chunk<E> *> vec1;
+  std::vector<Chunk<E> *> vec2;
+
+  for (Chunk<E> *chunk : ctx.chunks)
+    if (!is_deferred(chunk))
+      (is_reloc(chunk) ? vec2 : vec1).push_back(chunk);
+
+  for (std::span<Chunk<E> *> vec : {std::span(vec1), std::span(vec2)}) {
+    if (ctx.arg.memory_limit) {
+      copy_in_waves(ctx, vec, copy);
+    } else if (ctx.numa) {
+      copy_on_numa_nodes(ctx, vec, t, [&](Chunk<E> *chunk) { copy(*chunk); });
+    } else {
+      tbb::parallel_for_each(vec, [&](Chunk<E> *chunk) { copy(*chunk); });
+    }
+  }
+
+  write_compressed_debug_sections(ctx);
 
   // Undefined symbols in SHF_ALLOC sections are found by scan_relocations(),
   // but those in non-SHF_ALLOC sections cannot be found until we copy section
@@ -2486,10 +2698,106 @@ void fix_synthetic_symbols(Context<E> &ctx) {
       get_symbol(ctx, ord.name)->set_output_section(sections[0]);
 }
 
+// If --pack-dyn-relocs=android is given, .rel.dyn is encoded in the
+// Android packed relocation format. The size of the packed table
+// depends on the contents of relocations and thus on the memory layout,
+// which in turn depends on the size of the table. Like lld, we solve
+// this by iteration. We generate the dynamic relocations for the
+// current layout, encode them, and fix the layout with the new size.
+// We repeat this until the table fits in the reserved space. The size
+// never decreases after the first round, so this terminates. Usually,
+// the second round is the last one because sections after the table
+// move together.
+//
+// Only the chunks and input sections that emit dynamic relocations are
+// written, each to its own scratch buffer. Diagnostics are suppressed
+// because the same relocations are applied again when we actually
+// write the output file.
+template <typename E>
+i64 set_android_reldyn_size(Context<E> &ctx, i64 filesize) {
+  Timer t(ctx, "set_android_reldyn_size");
+  RelDynSection<E> &sec = *ctx.reldyn;
+
+  auto get_packed_size = [&] {
+    ctx.suppress_diagnostics = true;
+
+    tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
+      if (chunk->get_reldyn_size(ctx)) {
+        std::vector<u8> buf(chunk->shdr.sh_size);
+        chunk->write_to(ctx, buf.data());
+      }
+    });
+
+    // InputSection::scan_relocations() has assigned each section the
+    // offset of its first dynamic relocation within the file, so a
+    // section has dynamic relocations if the next one starts later.
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+      if (file->num_dynrel == 0)
+        return;
+
+      std::vector<InputSection<E> *> vec;
+      for (std::unique_ptr<InputSection<E>> &isec : file->sections)
+        if (isec && isec->is_alive && (isec->shdr().sh_flags & SHF_ALLOC))
+          vec.push_back(isec.get());
+
+      for (i64 i = 0; i < vec.size(); i++) {
+        i64 end = (i + 1 < vec.size()) ? vec[i + 1]->reldyn_offset
+                                       : file->num_dynrel * sizeof(ElfRel<E>);
+        if (vec[i]->reldyn_offset < end) {
+          std::vector<u8> buf(vec[i]->sh_size);
+          vec[i]->write_to(ctx, buf.data());
+        }
+      }
+    });
+
+    ctx.suppress_diagnostics = false;
+    sec.sort(ctx);
+    return (i64)sec.encode_android(ctx).size();
+  };
+
+  i64 unpacked_size = sec.shdr.sh_size;
+  i64 size = get_packed_size();
+
+  for (;;) {
+    // On RISC-V, sections have been shrunk for the current layout, and
+    // they may not be moved by anything other than multiples of the
+    // page size.
+    if constexpr (is_riscv<E>) {
+      i64 delta = size - unpacked_size;
+      if (delta < 0)
+        delta = -(i64)align_down(-delta, ctx.page_size);
+      else
+        delta = align_to(delta, ctx.page_size);
+      size = unpacked_size + delta;
+    }
+
+    sec.android_size = size;
+    sec.update_shdr(ctx);
+    filesize = set_osec_offsets(ctx);
+    fix_synthetic_symbols(ctx);
+
+    i64 size2 = get_packed_size();
+    if (size2 <= size)
+      return filesize;
+    size = size2;
+  }
+}
+
+// Replace .debug_* sections with compressed ones and start compressing
+// them in the background. Compressed sections and the section header
+// are moved to the end of the file, so that the other sections' file
+// offsets don't depend on the compressed sizes. That allows us to copy
+// other sections to the output file while compressing debug sections.
+// Since the compressed sizes are not known yet, compressed sections are
+// laid out as empty sections here. The output file is extended later by
+// write_compressed_debug_sections().
 template <typename E>
 i64 compress_debug_sections(Context<E> &ctx) {
   Timer t(ctx, "compress_debug_sections");
 
+  std::vector<CompressedSection<E> *> sections;
+  std::mutex mu;
+
   tbb::parallel_for((i64)0, (i64)ctx.chunks.size(), [&](i64 i) {
     Chunk<E> &chunk = *ctx.chunks[i];
 
@@ -2497,9 +2805,24 @@ i64 compress_debug_sections(Context<E> &ctx) {
         !chunk.name.starts_with(".debug"))
       return;
 
-    Chunk<E> *comp = new CompressedSection<E>(ctx, chunk);
+    CompressedSection<E> *comp = new CompressedSection<E>(ctx, chunk);
     ctx.chunk_pool.emplace_back(comp);
     ctx.chunks[i] = comp;
+
+    std::scoped_lock lock(mu);
+    sections.push_back(comp);
+  });
+
+  std::stable_partition(ctx.chunks.begin(), ctx.chunks.end(),
+                        [&](Chunk<E> *chunk) {
+    return !(chunk->shdr.sh_flags & SHF_COMPRESSED) && chunk != ctx.shdr;
+  });
+
+  ctx.compress_tg.run([&ctx, sections] {
+    Timer t(ctx, "compress_debug_sections_background");
+    tbb::parallel_for_each(sections, [&](CompressedSection<E> *sec) {
+      sec->compress(ctx);
+    });
   });
 
   ctx.shstrtab->update_shdr(ctx);
@@ -2593,6 +2916,8 @@ void show_stats(Context<E> &ctx) {
   static Counter num_output_chunks("output_chunks", ctx.chunks.size());
   static Counter num_objs("num_objs", ctx.objs.size());
   static Counter num_dsos("num_dsos", ctx.dsos.size());
+  static Counter peak_rss("peak_rss_bytes", get_peak_rss());
+  add_hw_counter_stats();
 
   if constexpr (needs_thunk<E>) {
     static Counter thunk_bytes("thunk_bytes");
@@ -2602,10 +2927,38 @@ void show_stats(Context<E> &ctx) {
           thunk_bytes += thunk->size();
   }
 
+  // Estimate the memory usage of major data structures. These are
+  // computed by walking the data structures here, so they don't slow
+  // down the linker unless --stats is given.
+  i64 obj_bytes = 0;
+  for (std::unique_ptr<ObjectFile<E>> &file : ctx.obj_pool)
+    obj_bytes += file->get_memory_usage();
+
+  i64 merged_bytes = 0;
+  for (std::unique_ptr<MergedSection<E>> &sec : ctx.merged_sections)
+    merged_bytes += sec->get_memory_usage();
+
+  // Symbols themselves are allocated from the arena and counted in
+  // mem_arena, so this is only the hash map's own nodes and buckets.
+  // A node holds a key-value pair, a lock and a link to the next node.
+  using SymbolMap = decltype(ctx.symbol_map);
+  i64 symbol_map_bytes =
+    ctx.symbol_map.size() * (sizeof(typename SymbolMap::value_type) + 16) +
+    ctx.symbol_map.bucket_count() * 16;
+
+  static Counter mem_objs("mem_object_files", obj_bytes);
+  static Counter mem_arena("mem_arena", get_arena_size());
+  static Counter mem_strings("mem_string_pool", ctx.string_pool_size);
+  static Counter mem_merged("mem_merged_section_maps", merged_bytes);
+  static Counter mem_symbols("mem_symbol_map", symbol_map_bytes);
+  add_malloc_stats();
+
   Counter::print();
 
   for (std::unique_ptr<MergedSection<E>> &sec : ctx.merged_sections)
     sec->print_stats(ctx);
+
+  print_memory_stats(ctx.timer_records);
 }
 
 using E = MOLD_TARGET;
@@ -2634,6 +2987,7 @@ template void claim_unresolved_symbols(Context<E> &);
 template void scan_relocations(Context<E> &);
 template void report_undef_errors(Context<E> &);
 template void create_reloc_sections(Context<E> &);
+template void construct_crel(Context<E> &);
 template void copy_chunks(Context<E> &);
 template void construct_relr(Context<E> &);
 template void create_output_symtab(Context<E> &);
@@ -2645,6 +2999,7 @@ template void clear_padding(Context<E> &);
 template void compute_section_headers(Context<E> &);
 template i64 set_osec_offsets(Context<E> &);
 template void fix_synthetic_symbols(Context<E> &);
+template i64 set_android_reldyn_size(Context<E> &, i64);
 template i64 compress_debug_sections(Context<E> &);
 template void write_dependency_file(Context<E> &);
 template void show_stats(Context<E> &);
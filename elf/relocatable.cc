@@ -78,7 +78,8 @@ static void create_comdat_group_sections(Context<E> &ctx) {
       std::vector<Chunk<E> *> members;
       for (u32 j : ref.members) {
         const ElfShdr<E> &shdr = file.elf_sections[j];
-        if (shdr.sh_type == (E::is_rela ? SHT_RELA : SHT_REL)) {
+        if (shdr.sh_type == (E::is_rela ? SHT_RELA : SHT_REL) ||
+            shdr.sh_type == SHT_CREL) {
           InputSection<E> &isec = *file.sections[shdr.sh_info];
           members.push_back(isec.output_section->reloc_sec.get());
         } else {
@@ -167,6 +168,9 @@ void combine_objects(Context<E> &ctx) {
 
   compute_section_headers(ctx);
 
+  if (ctx.arg.z_crel)
+    construct_crel(ctx);
+
   i64 filesize = r_set_osec_offsets(ctx);
   ctx.output_file =
     OutputFile<Context<E>>::open(ctx, ctx.arg.output, filesize, 0666);
@@ -16,6 +16,18 @@ namespace mold::macho {
 
 static const char helpmsg[] = R"(
 Sold-specific options:
+  --jobserver                 Limit threads by make's jobserver (default)
+    --no-jobserver
+  --library-index             Index library search directories (default)
+    --no-library-index
+  --library-index-cache=FILE  Cache listings of library search directories in FILE
+  --memory-limit=SIZE         Copy output sections in waves to fit in SIZE bytes
+  --perf=[text,json,trace:FILE]
+                              Print performance statistics as text or JSON,
+                              or write a trace-event timeline to FILE
+  --perf-counters             Record hardware performance counters for --perf
+  --prefetch                  Read input files ahead in the background (default)
+    --no-prefetch
   --print-dependencies        Print input file dependency information
 
 lld-compatible options:
@@ -337,7 +349,37 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       exit(0);
     }
 
-    if (read_flag("--print-dependencies")) {
+    if (read_flag("--jobserver")) {
+      ctx.arg.jobserver = true;
+    } else if (read_flag("--no-jobserver")) {
+      ctx.arg.jobserver = false;
+    } else if (read_flag("--library-index")) {
+      ctx.arg.library_index = true;
+    } else if (read_flag("--no-library-index")) {
+      ctx.arg.library_index = false;
+    } else if (read_joined("--library-index-cache=")) {
+      ctx.arg.library_index_cache = arg;
+    } else if (read_joined("--memory-limit=")) {
+      std::optional<i64> size = parse_size(arg);
+      if (!size)
+        Fatal(ctx) << "invalid --memory-limit argument: " << arg;
+      ctx.arg.memory_limit = *size;
+    } else if (read_flag("--prefetch")) {
+      ctx.arg.prefetch = true;
+    } else if (read_flag("--no-prefetch")) {
+      ctx.arg.prefetch = false;
+    } else if (read_flag("--perf-counters")) {
+      ctx.arg.perf_counters = true;
+    } else if (read_joined("--perf=")) {
+      if (arg == "text")
+        ctx.arg.perf = true;
+      else if (arg == "json")
+        ctx.arg.perf_json = true;
+      else if (arg.starts_with("trace:") && arg.size() > 6)
+        ctx.arg.perf_trace = arg.substr(6);
+      else
+        Fatal(ctx) << "unknown --perf argument: " << arg;
+    } else if (read_flag("--print-dependencies")) {
       ctx.arg.print_dependencies = true;
     } else if (read_flag("--strict-auto-link")) {
     } else if (read_joined("-F")) {
@@ -852,10 +852,117 @@ static void fix_synthetic_symbol_values(Context<E> &ctx) {
   }
 }
 
+// For --memory-limit. After a section is written, we ask the kernel to
+// reclaim the pages of its input sections. Input files are mapped with
+// MAP_PRIVATE, so we use MADV_PAGEOUT instead of MADV_DONTNEED, which
+// would discard pages we may have modified in place.
+template <typename E>
+static void release_input_pages(OutputSection<E> &osec) {
+#ifdef MADV_PAGEOUT
+  static const u64 page_size = sysconf(_SC_PAGESIZE);
+
+  for (i64 i = 0; i < osec.members.size(); i++) {
+    InputSection<E> &isec = *osec.members[i]->isec;
+    if (i > 0 && osec.members[i - 1]->isec == &isec)
+      continue;
+
+    MappedFile<Context<E>> *mf = isec.file.mf;
+    if (!mf)
+      continue;
+    while (mf->parent)
+      mf = mf->parent;
+
+    const u8 *data = (u8 *)isec.contents.data();
+    i64 size = isec.contents.size();
+    if (!mf->data || data < mf->data || mf->data + mf->size < data + size)
+      continue;
+
+    // An archive member shares pages with its neighbors, so we release
+    // only pages that are entirely within the section.
+    u64 begin = align_to((u64)data, page_size);
+    u64 end = ((u64)data + size) & ~(page_size - 1);
+    if (begin < end)
+      madvise((void *)begin, end - begin, MADV_PAGEOUT);
+  }
+#endif
+}
+
+// For --memory-limit. Sections are written in waves, each of which
+// writes at most as many bytes as the remaining memory budget. After
+// each wave, written pages are flushed to the file and dropped from our
+// address space, and so are the input pages that have been copied.
+// Unlike the ELF linker, we don't split a section into smaller pieces.
+template <typename E>
+static void copy_sections_in_waves(Context<E> &ctx, Timer<Context<E>> &t) {
+  constexpr i64 min_budget = 1024 * 1024;
+
+  auto get_budget = [&] {
+    return std::max(ctx.arg.memory_limit - get_rss(), min_budget);
+  };
+
+  std::vector<Chunk<E> *> chunks;
+
+  for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments) {
+    if constexpr (is_x86<E>)
+      if (seg->cmd.get_segname() == "__TEXT")
+        memset(ctx.buf + seg->cmd.fileoff, 0x90, seg->cmd.filesize);
+
+    for (Chunk<E> *sec : seg->chunks)
+      if (sec->hdr.type != S_ZEROFILL)
+        chunks.push_back(sec);
+  }
+
+  auto flush = [&](Chunk<E> *sec) {
+#ifndef _WIN32
+    if (!ctx.output_file->is_mmapped || sec->hdr.size == 0)
+      return;
+
+    static const u64 page_size = sysconf(_SC_PAGESIZE);
+    u8 *begin = ctx.buf + sec->hdr.offset;
+    u8 *end = begin + sec->hdr.size;
+    begin = (u8 *)((u64)begin & ~(page_size - 1));
+    end = (u8 *)align_to((u64)end, page_size);
+    end = std::min(end, ctx.buf + ctx.output_file->filesize);
+
+    // Dirty pages can't be reclaimed until they are written back.
+    msync(begin, end - begin, MS_SYNC);
+    madvise(begin, end - begin, MADV_DONTNEED);
+#endif
+  };
+
+  for (i64 i = 0; i < chunks.size();) {
+    i64 budget = get_budget();
+    i64 j = i + 1;
+    i64 size = chunks[i]->hdr.size;
+    while (j < chunks.size() && size + chunks[j]->hdr.size <= budget)
+      size += chunks[j++]->hdr.size;
+
+    std::span<Chunk<E> *> wave(chunks.begin() + i, chunks.begin() + j);
+
+    tbb::parallel_for_each(wave, [&](Chunk<E> *sec) {
+      Timer t2(ctx, std::string(sec->hdr.get_sectname()), &t);
+      sec->copy_buf(ctx);
+    });
+
+    tbb::parallel_for_each(wave, flush);
+
+    tbb::parallel_for_each(wave, [&](Chunk<E> *sec) {
+      if (OutputSection<E> *osec = sec->to_osec())
+        release_input_pages(*osec);
+    });
+    i = j;
+  }
+}
+
 template <typename E>
 static void copy_sections_to_output_file(Context<E> &ctx) {
   Timer t(ctx, "copy_sections_to_output_file");
 
+  if (ctx.arg.memory_limit) {
+    copy_sections_in_waves(ctx, t);
+    return;
+  }
+
   tbb::parallel_for_each(ctx.segments,
                          [&](std::unique_ptr<OutputSegment<E>> &seg) {
     Timer t2(ctx, std::string(seg->cmd.get_segname()), &t);
@@ -982,6 +1089,46 @@ static bool has_dylib(Context<E> &ctx, std::string_view path) {
   return false;
 }
 
+// Returns the paths of input files in the command line order for
+// Prefetcher. A library given by `-l` is guessed from the library
+// index, so the result may not exactly match what we will read.
+template <typename E>
+static std::vector<std::string>
+get_prefetch_paths(Context<E> &ctx, std::span<std::string> args) {
+  std::vector<std::string> vec;
+
+  auto find_library = [&](std::string name) -> std::string {
+    // Without the index, we'd have to probe the file system here.
+    if (!ctx.library_index)
+      return "";
+
+    for (std::string &dir : ctx.arg.library_paths)
+      for (std::string ext : {".tbd", ".dylib", ".a"})
+        if (ctx.library_index->may_contain(dir, "lib" + name + ext))
+          return dir + "/lib" + name + ext;
+    return "";
+  };
+
+  for (i64 i = 0; i < args.size(); i++) {
+    std::string_view opt = args[i];
+
+    if (!opt.starts_with('-')) {
+      vec.push_back(args[i]);
+    } else if (opt == "-all_load" || opt == "-noall_load" ||
+               i + 1 == args.size()) {
+      continue;
+    } else if (opt == "-force_load" || opt == "-reexport_library") {
+      vec.push_back(args[++i]);
+    } else if (opt.ends_with("-l")) {
+      if (std::string path = find_library(args[++i]); !path.empty())
+        vec.push_back(path);
+    } else {
+      i++;
+    }
+  }
+  return vec;
+}
+
 template <typename E>
 static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
   Timer t(ctx, "read_input_files");
@@ -989,12 +1136,31 @@ static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
   std::unordered_set<std::string> libs;
   std::unordered_set<std::string> frameworks;
 
+  // Read the search directories up front so that we don't have to
+  // probe each of them for each library.
+  if (ctx.arg.library_index) {
+    std::vector<std::string> dirs = ctx.arg.library_paths;
+    append(dirs, ctx.arg.framework_paths);
+    ctx.library_index.reset(new DirectoryIndex(dirs, ctx.arg.library_index_cache));
+  }
+
+  auto may_contain = [&](std::string_view dir, std::string_view name) {
+    return !ctx.library_index || ctx.library_index->may_contain(dir, name);
+  };
+
+  // Start reading input files into the page cache so that parse
+  // tasks don't have to wait for the disk one page at a time.
+  std::unique_ptr<Prefetcher> prefetcher;
+  if (ctx.arg.prefetch)
+    prefetcher.reset(new Prefetcher(get_prefetch_paths(ctx, args)));
+
   auto search = [&](std::vector<std::string> names) -> MappedFile<Context<E>> * {
     for (std::string dir : ctx.arg.library_paths) {
       for (std::string name : names) {
         std::string path = dir + "/lib" + name;
-        if (MappedFile<Context<E>> *mf = MappedFile<Context<E>>::open(ctx, path))
-          return mf;
+        if (may_contain(dir, "lib" + name))
+          if (MappedFile<Context<E>> *mf = MappedFile<Context<E>>::open(ctx, path))
+            return mf;
         ctx.missing_files.insert(path);
       }
     }
@@ -1034,6 +1200,9 @@ static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
     std::tie(name, suffix) = split_string(name, ',');
 
     for (std::string path : ctx.arg.framework_paths) {
+      if (!may_contain(path, name + ".framework"))
+        continue;
+
       path = get_realpath(path + "/" + name + ".framework/" + name);
 
       if (!suffix.empty())
@@ -1265,8 +1434,14 @@ static void print_stats(Context<E> &ctx) {
 
   static Counter num_objs("num_objs", ctx.objs.size());
   static Counter num_dylibs("num_dylibs", ctx.dylibs.size());
+  static Counter peak_rss("peak_rss_bytes", get_peak_rss());
+  add_hw_counter_stats();
+
+  static Counter mem_arena("mem_arena", get_arena_size());
+  add_malloc_stats();
 
   Counter::print();
+  print_memory_stats(ctx.timer_records);
 }
 
 template <typename E>
@@ -1295,9 +1470,22 @@ int macho_main(int argc, char **argv) {
 
   Timer t(ctx, "all");
 
+  // Hardware counters count events only of threads created after they
+  // are opened, so we need to open them before TBB spawns workers.
+  if (ctx.arg.perf_counters && !open_hw_counters())
+    Warn(ctx) << "--perf-counters: hardware performance counters are not"
+              << " available: " << errno_string();
+
   tbb::global_control tbb_cont(tbb::global_control::max_allowed_parallelism,
                                ctx.arg.thread_count);
 
+  // If we are invoked by `make -jN`, use only as many threads as the
+  // number of job slots we can get from make.
+  if (ctx.arg.jobserver)
+    ctx.jobserver = JobServer::create(ctx.arg.thread_count);
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
   if (ctx.arg.adhoc_codesign)
     ctx.code_sig.reset(new CodeSignatureSection<E>(ctx));
 
@@ -1359,6 +1547,9 @@ int macho_main(int argc, char **argv) {
 
   compute_import_export(ctx);
 
+  if (ctx.jobserver)
+    ctx.jobserver->grow();
+
   scan_relocations(ctx);
 
   i64 output_size = assign_offsets(ctx);
@@ -1379,6 +1570,9 @@ int macho_main(int argc, char **argv) {
   else if (ctx.arg.uuid == UUID_HASH)
     compute_uuid(ctx);
 
+  if (ctx.jobserver)
+    ctx.jobserver->release();
+
   ctx.output_file->close(ctx);
 
   if (!ctx.arg.dependency_info.empty())
@@ -1390,6 +1584,17 @@ int macho_main(int argc, char **argv) {
   if (ctx.arg.perf)
     print_timer_records(ctx.timer_records);
 
+  if (ctx.arg.perf_json)
+    print_timer_records_json(ctx.timer_records, std::cout);
+
+  if (!ctx.arg.perf_trace.empty()) {
+    std::ofstream out(ctx.arg.perf_trace);
+    if (!out.is_open())
+      Fatal(ctx) << "cannot open " << ctx.arg.perf_trace << ": "
+                 << errno_string();
+    print_timer_records_trace(ctx.timer_records, out);
+  }
+
   if (ctx.arg.stats)
     print_stats(ctx);
 
@@ -287,6 +287,9 @@ public:
                u32 secidx);
   void parse_relocations(Context<E> &ctx);
 
+  static void *operator new(size_t size) { return arena_alloc(size); }
+  static void operator delete(void *) {}
+
   ObjectFile<E> &file;
   const MachSection<E> &hdr;
   u32 secidx = 0;
@@ -303,6 +306,9 @@ std::ostream &operator<<(std::ostream &out, const InputSection<E> &sec);
 template <typename E>
 class Subsection {
 public:
+  static void *operator new(size_t size) { return arena_alloc(size); }
+  static void operator delete(void *) {}
+
   u64 get_addr(Context<E> &ctx) const {
     return isec->osec.hdr.addr + output_offset;
   }
@@ -1125,9 +1131,14 @@ struct Context {
     bool function_starts = true;
     bool implicit_dylibs = true;
     bool init_offsets = false;
+    bool jobserver = true;
+    bool library_index = true;
     bool mark_dead_strippable_dylib = false;
     bool noinhibit_exec = false;
     bool perf = false;
+    bool perf_counters = false;
+    bool perf_json = false;
+    bool prefetch = true;
     bool print_dependencies = false;
     bool quick_exit = true;
     bool search_paths_first = true;
@@ -1139,6 +1150,7 @@ struct Context {
     i64 arch = CPU_TYPE_ARM64;
     i64 filler = 0;
     i64 headerpad = 256;
+    i64 memory_limit = 0;
     i64 pagezero_size = 0;
     i64 platform = PLATFORM_MACOS;
     i64 stack_size = 0;
@@ -1149,11 +1161,13 @@ struct Context {
     std::string executable_path;
     std::string final_output;
     std::string install_name;
+    std::string library_index_cache;
     std::string lto_library;
     std::string map;
     std::string object_path_lto;
     std::string oso_prefix;
     std::string output = "a.out";
+    std::string perf_trace;
     std::string plugin;
     std::string umbrella;
     std::vector<AddEmptySectionOption> add_empty_section;
@@ -1179,6 +1193,7 @@ struct Context {
 
   u8 uuid[16] = {};
   bool has_error = false;
+  bool suppress_diagnostics = false;
   u64 tls_begin = 0;
   std::string cwd = std::filesystem::current_path().string();
 
@@ -1191,9 +1206,13 @@ struct Context {
   u8 *buf;
   bool overwrite_output_file = false;
 
+  std::unique_ptr<JobServer> jobserver;
+  std::unique_ptr<DirectoryIndex> library_index;
+
   tbb::concurrent_vector<std::unique_ptr<ObjectFile<E>>> obj_pool;
   tbb::concurrent_vector<std::unique_ptr<DylibFile<E>>> dylib_pool;
   tbb::concurrent_vector<std::unique_ptr<u8[]>> string_pool;
+  std::atomic<i64> string_pool_size = 0;
   tbb::concurrent_vector<std::unique_ptr<MappedFile<Context<E>>>> mf_pool;
   std::vector<std::unique_ptr<Chunk<E>>> chunk_pool;
 
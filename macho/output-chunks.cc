@@ -950,124 +950,6 @@ void LazyBindSection<E>::copy_buf(Context<E> &ctx) {
   write_vector(ctx.buf + this->hdr.offset, contents);
 }
 
-inline i64 ExportEncoder::finish() {
-  tbb::parallel_sort(entries, [](const Entry &a, const Entry &b) {
-    return a.name < b.name;
-  });
-
-  // Construct a trie
-  TrieNode node;
-  tbb::task_group tg;
-  construct_trie(node, entries, 0, &tg, entries.size() / 32, true);
-  tg.wait();
-
-  if (node.prefix.empty())
-    root = std::move(node);
-  else
-    root.children.emplace_back(new TrieNode(std::move(node)));
-
-  // Set output offsets to trie nodes. Since a serialized trie node
-  // contains output offsets of other nodes in the variable-length
-  // ULEB format, it unfortunately needs more than one iteration.
-  // We need to repeat until the total size of the serialized trie
-  // converges to obtain the optimized output. However, in reality,
-  // repeating this step twice is enough. Size reduction on third and
-  // further iterations is negligible.
-  set_offset(root, 0);
-  return set_offset(root, 0);
-}
-
-static i64 common_prefix_len(std::string_view x, std::string_view y) {
-  i64 i = 0;
-  while (i < x.size() && i < y.size() && x[i] == y[i])
-    i++;
-  return i;
-}
-
-void
-inline ExportEncoder::construct_trie(TrieNode &node, std::span<Entry> entries,
-                                     i64 len, tbb::task_group *tg,
-                                     i64 grain_size, bool divide) {
-  i64 new_len = common_prefix_len(entries[0].name, entries.back().name);
-
-  if (new_len > len) {
-    node.prefix = entries[0].name.substr(len, new_len - len);
-    if (entries[0].name.size() == new_len) {
-      node.is_leaf = true;
-      node.flags = entries[0].flags;
-      node.addr = entries[0].addr;
-      entries = entries.subspan(1);
-    }
-  }
-
-  for (i64 i = 0; i < entries.size();) {
-    auto it = std::partition_point(entries.begin() + i + 1, entries.end(),
-                                   [&](const Entry &ent) {
-      return entries[i].name[new_len] == ent.name[new_len];
-    });
-    i64 j = it - entries.begin();
-
-    TrieNode *child = new TrieNode;
-    std::span<Entry> subspan = entries.subspan(i, j - i);
-
-    if (divide && j - i < grain_size) {
-      tg->run([=, this] {
-        construct_trie(*child, subspan, new_len, tg, grain_size, false);
-      });
-    } else {
-      construct_trie(*child, subspan, new_len, tg, grain_size, divide);
-    }
-
-    node.children.emplace_back(child);
-    i = j;
-  }
-}
-
-inline i64 ExportEncoder::set_offset(TrieNode &node, i64 offset) {
-  node.offset = offset;
-
-  i64 size = 0;
-  if (node.is_leaf) {
-    size = uleb_size(node.flags) + uleb_size(node.addr);
-    size += uleb_size(size);
-  } else {
-    size = 1;
-  }
-
-  size++; // # of children
-
-  for (std::unique_ptr<TrieNode> &child : node.children) {
-    // +1 for NUL byte
-    size += child->prefix.size() + 1 + uleb_size(child->offset);
-  }
-
-  for (std::unique_ptr<TrieNode> &child : node.children)
-    size += set_offset(*child, offset + size);
-  return size;
-}
-
-inline void ExportEncoder::write_trie(u8 *start, TrieNode &node) {
-  u8 *buf = start + node.offset;
-
-  if (node.is_leaf) {
-    buf += write_uleb(buf, uleb_size(node.flags) + uleb_size(node.addr));
-    buf += write_uleb(buf, node.flags);
-    buf += write_uleb(buf, node.addr);
-  } else {
-    *buf++ = 0;
-  }
-
-  *buf++ = node.children.size();
-
-  for (std::unique_ptr<TrieNode> &child : node.children) {
-    buf += write_string(buf, child->prefix);
-    buf += write_uleb(buf, child->offset);
-  }
-
-  for (std::unique_ptr<TrieNode> &child : node.children)
-    write_trie(start, *child);
-}
-
 template <typename E>
 void ExportSection<E>::compute_size(Context<E> &ctx) {
   auto get_flags = [](Symbol<E> &sym) {
@@ -0,0 +1,569 @@
+// This is a microbenchmark for the data structures and helper functions
+// that are hot in a typical link, such as ConcurrentMap, HyperLogLog,
+// MultiGlob, the Mach-O export trie encoder, ULEB128 encoding and the
+// debug section compressors.
+//
+// Whole-link benchmarks (test/bench/mold-bench.py) tell whether the
+// linker got slower, but not why. This program runs each primitive in
+// isolation with a varying number of threads, so that a change to e.g.
+// ConcurrentMap's probing or sharding can be evaluated by itself.
+//
+// Usage: mold-microbench [--filter=REGEX] [--threads=1,2,4,...]
+//                        [--min-time=SECONDS] [--scale=N] [--skew-bits=N]
+//
+// The output format mimics Google Benchmark's. Each line shows the
+// median wall time of an iteration, the throughput and the speedup
+// relative to the first thread count in the sweep.
+
+#include "../../common/common.h"
+#include "config.h"
+
+#if MOLD_IS_SOLD
+# include "../../macho/mold.h"
+#endif
+
+#include <chrono>
+#include <random>
+#include <regex>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+
+namespace mold {
+
+struct Options {
+  std::regex filter{""};
+  std::vector<i64> threads;
+  double min_time = 0.5;
+  i64 min_iters = 3;
+  double scale = 1;
+  i64 skew_bits = 4;
+};
+
+struct Benchmark {
+  std::string name;
+
+  // The number of items (or bytes if `is_bytes` is true) processed by
+  // one iteration of `run`. Used to compute the throughput.
+  i64 items = 0;
+  bool is_bytes = false;
+
+  // `setup` is called before each iteration and is not timed.
+  std::function<void()> setup;
+  std::function<void()> run;
+
+  // Returns additional counters to be printed, e.g. probe lengths.
+  std::function<std::string()> counters;
+};
+
+static Options opt;
+static std::vector<Benchmark> benchmarks;
+
+static double now() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static double median(std::vector<double> vec) {
+  sort(vec);
+  return vec[vec.size() / 2];
+}
+
+static void run_benchmark(Benchmark &bench) {
+  double base = 0;
+
+  for (i64 nthreads : opt.threads) {
+    tbb::global_control gc(tbb::global_control::max_allowed_parallelism,
+                           nthreads);
+
+    std::vector<double> samples;
+    double total = 0;
+
+    while (samples.size() < opt.min_iters || total < opt.min_time) {
+      if (bench.setup)
+        bench.setup();
+      double t = now();
+      bench.run();
+      samples.push_back(now() - t);
+      total += samples.back();
+    }
+
+    double t = median(samples);
+    if (base == 0)
+      base = t;
+
+    std::string name = bench.name + "/threads:" + std::to_string(nthreads);
+    std::string rate = bench.is_bytes
+      ? std::to_string((i64)(bench.items / t / 1024 / 1024)) + " MiB/s"
+      : std::to_string((i64)(bench.items / t / 1000)) + " k/s";
+    std::string extra = bench.counters ? bench.counters() : "";
+
+    printf("%-40s %10.3f ms %16s %6.2fx %6zu  %s\n", name.c_str(), t * 1000,
+           rate.c_str(), base / t, samples.size(), extra.c_str());
+    fflush(stdout);
+  }
+}
+
+// Returns true if any of the given benchmarks is selected by --filter.
+// Used to skip generating test data for benchmarks that don't run.
+static bool selected(std::initializer_list<std::string> names) {
+  for (const std::string &name : names)
+    if (std::regex_search(name, opt.filter))
+      return true;
+  return false;
+}
+
+static i64 scaled(i64 n) {
+  return std::max<i64>(1, n * opt.scale);
+}
+
+// Returns a deterministic list of symbol-like strings.
+static std::vector<std::string> make_names(i64 n, u64 seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<std::string> vec;
+  vec.reserve(n);
+
+  static const char *prefixes[] = {
+    "_ZN4mold3elf", "_ZNSt6vector", "__cxx_global_var_init", ".L.str.",
+    "_ZN4llvm", "_OBJC_CLASS_$_", "",
+  };
+
+  for (i64 i = 0; i < n; i++) {
+    const char *prefix = prefixes[rng() % std::size(prefixes)];
+    vec.push_back(prefix + std::to_string(rng() % 100000) + "_" +
+                  std::to_string(i));
+  }
+  return vec;
+}
+
+//
+// ConcurrentMap
+//
+
+struct MapValue {
+  void *ptr = nullptr;
+  u32 offset = 0;
+  u32 p2align = 0;
+};
+
+// Registers a benchmark inserting `keys` to a ConcurrentMap. If
+// `skew` is true, half of the hashes have their low bits cleared, which
+// makes many keys start probing from the same bucket. That is what we
+// see when a large string table has many strings with colliding hashes.
+static void add_concurrent_map(std::string name,
+                               std::shared_ptr<std::vector<std::string>> keys,
+                               i64 num_unique, bool skew) {
+  auto hashes = std::make_shared<std::vector<u64>>(keys->size());
+  for (i64 i = 0; i < keys->size(); i++) {
+    (*hashes)[i] = hash_string((*keys)[i]);
+    if (skew && i % 2)
+      (*hashes)[i] &= ~(u64)((1 << opt.skew_bits) - 1);
+  }
+
+  auto map = std::make_shared<ConcurrentMap<MapValue>>();
+
+  Benchmark bench;
+  bench.name = name;
+  bench.items = keys->size();
+
+  // We aim 2/3 occupation ratio, just like MergedSection does.
+  bench.setup = [=] { map->resize(num_unique * 3 / 2); };
+
+  bench.run = [=] {
+    tbb::parallel_for(tbb::blocked_range<i64>(0, keys->size(), 4096),
+                      [&](const tbb::blocked_range<i64> &r) {
+      for (i64 i = r.begin(); i < r.end(); i++)
+        map->insert((*keys)[i], (*hashes)[i], {});
+    });
+  };
+
+  // Compute the distance between each key's home bucket and the bucket
+  // where it is actually stored.
+  bench.counters = [=] {
+    i64 mask = map->nbuckets / map->NUM_SHARDS - 1;
+    i64 total = 0;
+    i64 max = 0;
+    i64 overflow = 0;
+
+    for (i64 i = 0; i < keys->size(); i++) {
+      MapValue *val = map->insert((*keys)[i], (*hashes)[i], {}).first;
+      if (!val) {
+        overflow++;
+        continue;
+      }
+      i64 home = (*hashes)[i] & (map->nbuckets - 1);
+      i64 dist = ((val - map->values) - home) & mask;
+      total += dist;
+      max = std::max(max, dist);
+    }
+
+    char buf[100];
+    snprintf(buf, sizeof(buf), "avg_probe=%.2f max_probe=%ld overflow=%ld",
+             (double)total / keys->size(), (long)max, (long)overflow);
+    return std::string(buf);
+  };
+
+  benchmarks.push_back(bench);
+}
+
+static void add_concurrent_map_benchmarks() {
+  if (!selected({"ConcurrentMap/unique", "ConcurrentMap/skewed",
+                 "ConcurrentMap/duplicated"}))
+    return;
+
+  i64 n = scaled(1'000'000);
+
+  auto unique = std::make_shared<std::vector<std::string>>(make_names(n, 1));
+  add_concurrent_map("ConcurrentMap/unique", unique, n, false);
+  add_concurrent_map("ConcurrentMap/skewed", unique, n, true);
+
+  // Each key appears four times in random order, as identical strings
+  // in mergeable sections of different object files do.
+  auto dup = std::make_shared<std::vector<std::string>>();
+  for (i64 i = 0; i < 4; i++)
+    dup->insert(dup->end(), unique->begin(), unique->begin() + n / 4);
+  std::shuffle(dup->begin(), dup->end(), std::mt19937_64(2));
+  add_concurrent_map("ConcurrentMap/duplicated", dup, n / 4, false);
+}
+
+//
+// HyperLogLog
+//
+
+static void add_hyperloglog_benchmarks() {
+  if (!selected({"HyperLogLog/insert_merge"}))
+    return;
+
+  i64 n = scaled(10'000'000);
+  auto hashes = std::make_shared<std::vector<u64>>(n);
+  std::mt19937_64 rng(3);
+  for (u64 &h : *hashes)
+    h = rng();
+
+  auto estimate = std::make_shared<i64>();
+
+  // Each task computes a local estimate and merges it to the global one
+  // in the same way as mergeable sections are processed.
+  Benchmark bench;
+  bench.name = "HyperLogLog/insert_merge";
+  bench.items = n;
+  bench.run = [=] {
+    HyperLogLog global;
+    tbb::parallel_for(tbb::blocked_range<i64>(0, n, 65536),
+                      [&](const tbb::blocked_range<i64> &r) {
+      HyperLogLog local;
+      for (i64 i = r.begin(); i < r.end(); i++)
+        local.insert((*hashes)[i]);
+      global.merge(local);
+    });
+    *estimate = global.get_cardinality();
+  };
+  bench.counters = [=] {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "error=%.2f%%",
+             std::abs((double)*estimate / n - 1) * 100);
+    return std::string(buf);
+  };
+  benchmarks.push_back(bench);
+}
+
+//
+// MultiGlob
+//
+
+static std::vector<std::string> make_patterns(i64 n) {
+  std::vector<std::string> vec;
+  for (i64 i = 0; i < n; i++) {
+    std::string s = std::to_string(i);
+    switch (i % 4) {
+    case 0: vec.push_back("_ZN4mold3elf" + s + "_*"); break;
+    case 1: vec.push_back("*_" + s); break;
+    case 2: vec.push_back("_ZNSt6vector" + s); break;
+    case 3: vec.push_back("_ZN4llvm?" + s + "[0-9]*"); break;
+    }
+  }
+  return vec;
+}
+
+static void add_multi_glob_benchmarks() {
+  if (!selected({"MultiGlob/compile", "MultiGlob/find"}))
+    return;
+
+  auto patterns = std::make_shared<std::vector<std::string>>(
+    make_patterns(scaled(10'000)));
+  auto names = std::make_shared<std::vector<std::string>>(
+    make_names(scaled(1'000'000), 4));
+  auto glob = std::make_shared<std::unique_ptr<MultiGlob>>();
+
+  auto compile = [=] {
+    glob->reset(new MultiGlob);
+    for (i64 i = 0; i < patterns->size(); i++)
+      (*glob)->add((*patterns)[i], i);
+
+    // MultiGlob compiles patterns on the first call of find().
+    (*glob)->find("");
+  };
+
+  Benchmark bench;
+  bench.name = "MultiGlob/compile";
+  bench.items = patterns->size();
+  bench.run = compile;
+  benchmarks.push_back(bench);
+
+  auto matches = std::make_shared<std::atomic_int64_t>();
+
+  bench = {};
+  bench.name = "MultiGlob/find";
+  bench.items = names->size();
+  bench.setup = [=] {
+    if (!*glob)
+      compile();
+    *matches = 0;
+  };
+  bench.run = [=] {
+    tbb::parallel_for(tbb::blocked_range<i64>(0, names->size(), 1024),
+                      [&](const tbb::blocked_range<i64> &r) {
+      i64 count = 0;
+      for (i64 i = r.begin(); i < r.end(); i++)
+        if ((*glob)->find((*names)[i]))
+          count++;
+      *matches += count;
+    });
+  };
+  bench.counters = [=] { return "matches=" + std::to_string(*matches); };
+  benchmarks.push_back(bench);
+}
+
+//
+// ExportEncoder
+//
+
+#if MOLD_IS_SOLD
+static void add_export_encoder_benchmarks() {
+  using macho::ExportEncoder;
+
+  if (!selected({"ExportEncoder/build"}))
+    return;
+
+  auto names = std::make_shared<std::vector<std::string>>(
+    make_names(scaled(1'000'000), 5));
+  auto enc = std::make_shared<std::unique_ptr<ExportEncoder>>();
+  auto buf = std::make_shared<std::vector<u8>>();
+
+  Benchmark bench;
+  bench.name = "ExportEncoder/build";
+  bench.items = names->size();
+  bench.setup = [=] {
+    enc->reset(new ExportEncoder);
+    for (i64 i = 0; i < names->size(); i++)
+      (*enc)->entries.push_back({(*names)[i], 0, (u64)i * 16});
+  };
+  bench.run = [=] {
+    buf->clear();
+    buf->resize((*enc)->finish());
+    (*enc)->write_trie(buf->data(), (*enc)->root);
+  };
+  bench.counters = [=] { return "size=" + std::to_string(buf->size()); };
+  benchmarks.push_back(bench);
+}
+#endif
+
+//
+// ULEB128
+//
+
+static void add_uleb_benchmarks() {
+  if (!selected({"ULEB/encode", "ULEB/decode"}))
+    return;
+
+  i64 n = scaled(20'000'000);
+  constexpr i64 chunk_size = 65536;
+
+  // Small values are much more common than large ones in real data,
+  // so the encoded size is geometrically distributed.
+  auto vals = std::make_shared<std::vector<u64>>(n);
+  std::mt19937_64 rng(6);
+  std::geometric_distribution<i64> dist(0.5);
+  for (u64 &v : *vals)
+    v = rng() & ((1ULL << std::min<i64>(7 * (dist(rng) + 1), 63)) - 1);
+
+  i64 nchunks = (n + chunk_size - 1) / chunk_size;
+  auto bufs = std::make_shared<std::vector<std::vector<u8>>>(nchunks);
+  for (std::vector<u8> &buf : *bufs)
+    buf.resize(chunk_size * 10);
+
+  Benchmark bench;
+  bench.name = "ULEB/encode";
+  bench.items = n;
+  bench.run = [=] {
+    tbb::parallel_for((i64)0, nchunks, [&](i64 i) {
+      u8 *p = (*bufs)[i].data();
+      i64 end = std::min(n, (i + 1) * chunk_size);
+      for (i64 j = i * chunk_size; j < end; j++)
+        p += write_uleb(p, (*vals)[j]);
+    });
+  };
+  benchmarks.push_back(bench);
+
+  auto sum = std::make_shared<std::atomic_uint64_t>();
+
+  bench = {};
+  bench.name = "ULEB/decode";
+  bench.items = n;
+  bench.setup = [=] { *sum = 0; };
+  bench.run = [=] {
+    tbb::parallel_for((i64)0, nchunks, [&](i64 i) {
+      u8 *p = (*bufs)[i].data();
+      i64 end = std::min(n, (i + 1) * chunk_size);
+      u64 x = 0;
+      for (i64 j = i * chunk_size; j < end; j++)
+        x += read_uleb(p);
+      *sum += x;
+    });
+  };
+  benchmarks.push_back(bench);
+}
+
+//
+// Compressors
+//
+
+// Returns data that compresses about as well as typical debug info.
+static std::vector<u8> make_compressible_data(i64 size) {
+  std::vector<std::string> words = make_names(4096, 7);
+  std::mt19937_64 rng(8);
+  std::vector<u8> vec;
+  vec.reserve(size + 100);
+
+  while (vec.size() < size) {
+    std::string &w = words[rng() % words.size()];
+    vec.insert(vec.end(), w.begin(), w.end());
+    vec.push_back(0);
+    for (i64 i = rng() % 8; i > 0; i--)
+      vec.push_back(rng());
+  }
+  vec.resize(size);
+  return vec;
+}
+
+template <typename Compressor>
+static void add_compressor_benchmarks(std::string name,
+                                      bool (*decompress)(std::string_view,
+                                                         u8 *, i64)) {
+  if (!selected({name + "/compress", name + "/decompress"}))
+    return;
+
+  i64 size = scaled(64 * 1024 * 1024);
+  auto in = std::make_shared<std::vector<u8>>(make_compressible_data(size));
+  auto out = std::make_shared<std::vector<u8>>();
+
+  Benchmark bench;
+  bench.name = name + "/compress";
+  bench.items = size;
+  bench.is_bytes = true;
+  bench.run = [=] {
+    Compressor c(in->data(), size);
+    out->resize(c.compressed_size);
+    c.write_to(out->data());
+  };
+  bench.counters = [=] {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "ratio=%.2f", (double)size / out->size());
+    return std::string(buf);
+  };
+  benchmarks.push_back(bench);
+
+  auto buf = std::make_shared<std::vector<u8>>(size);
+
+  bench = {};
+  bench.name = name + "/decompress";
+  bench.items = size;
+  bench.is_bytes = true;
+  bench.setup = [=] {
+    if (out->empty()) {
+      Compressor c(in->data(), size);
+      out->resize(c.compressed_size);
+      c.write_to(out->data());
+    }
+  };
+  bench.run = [=] {
+    std::string_view data((char *)out->data(), out->size());
+    if (!decompress(data, buf->data(), size))
+      ASSERT(false && "decompression failed");
+  };
+  benchmarks.push_back(bench);
+}
+
+static std::vector<i64> parse_threads(std::string_view arg) {
+  std::vector<i64> vec;
+  while (!arg.empty()) {
+    size_t pos = arg.find(',');
+    vec.push_back(std::stol(std::string(arg.substr(0, pos))));
+    if (pos == arg.npos)
+      break;
+    arg = arg.substr(pos + 1);
+  }
+  return vec;
+}
+
+static std::vector<i64> default_threads() {
+  i64 max = std::thread::hardware_concurrency();
+  std::vector<i64> vec;
+  for (i64 i = 1; i < max; i *= 2)
+    vec.push_back(i);
+  vec.push_back(max);
+  return vec;
+}
+
+} // namespace mold
+
+using namespace mold;
+
+int main(int argc, char **argv) {
+  for (i64 i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    auto read = [&](std::string_view name) {
+      if (!arg.starts_with(name))
+        return false;
+      arg = arg.substr(name.size());
+      return true;
+    };
+
+    if (read("--filter=")) {
+      opt.filter = std::regex(std::string(arg));
+    } else if (read("--threads=")) {
+      opt.threads = parse_threads(arg);
+    } else if (read("--min-time=")) {
+      opt.min_time = std::stod(std::string(arg));
+    } else if (read("--scale=")) {
+      opt.scale = std::stod(std::string(arg));
+    } else if (read("--skew-bits=")) {
+      opt.skew_bits = std::stol(std::string(arg));
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--filter=REGEX] [--threads=1,2,4,...]"
+                << " [--min-time=SECONDS] [--scale=N] [--skew-bits=N]\n";
+      return 1;
+    }
+  }
+
+  if (opt.threads.empty())
+    opt.threads = default_threads();
+
+  add_concurrent_map_benchmarks();
+  add_hyperloglog_benchmarks();
+  add_multi_glob_benchmarks();
+#if MOLD_IS_SOLD
+  add_export_encoder_benchmarks();
+#endif
+  add_uleb_benchmarks();
+  add_compressor_benchmarks<ZlibCompressor>("ZlibCompressor", zlib_decompress);
+  add_compressor_benchmarks<ZstdCompressor>("ZstdCompressor", zstd_decompress);
+
+  printf("%-40s %13s %16s %7s %6s  %s\n", "Benchmark", "Time",
+         "Throughput", "Speedup", "Iters", "Counters");
+
+  for (Benchmark &bench : benchmarks)
+    if (std::regex_search(bench.name, opt.filter))
+      run_benchmark(bench);
+  return 0;
+}
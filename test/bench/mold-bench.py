@@ -0,0 +1,641 @@
+#!/usr/bin/env python3
+#
+# This is a benchmark driver for mold. It generates synthetic input files
+# with deterministic generators, links them a few times with `--perf=json`
+# and compares the results against a baseline saved by a previous run.
+#
+# Each scenario stresses a different part of the linker:
+#
+#   functions  N objects x M functions with one section per function
+#   strings    Large mergeable string sections with many duplicates
+#   comdat     The same COMDAT groups (or weak definitions on Mach-O)
+#              duplicated in every object file
+#   archive    A big static archive from which half the members are
+#              extracted
+#   dylibs     Many shared libraries (or TBD files on Mach-O)
+#   debug      Large debug info sections
+#
+# ELF input files are compiled from generated C/C++ sources with the
+# host compiler. Mach-O input files are written directly by this script,
+# so Mach-O benchmarks don't need an SDK or a cross compiler and run on
+# any Linux box. No network access is needed.
+#
+# Usage:
+#
+#   mold-bench.py --mold ./mold [--scale 1.0] [--runs 5] [--filter REGEX]
+#                 [--baseline FILE] [--save-baseline]
+#
+# A scenario is reported as a regression only if its median wall time
+# got worse by more than both the relative threshold (--threshold) and
+# the noise observed in the baseline and the current runs. Noise is
+# estimated as the median absolute deviation (MAD) of the samples.
+
+import argparse
+import concurrent.futures
+import json
+import os
+import random
+import re
+import shutil
+import statistics
+import struct
+import subprocess
+import sys
+
+# Bump this if a generator changes so that stale inputs are regenerated.
+GENERATOR_VERSION = 1
+
+#
+# Common helpers
+#
+
+def write_file(path, data):
+  mode = 'wb' if isinstance(data, bytes) else 'w'
+  with open(path, mode) as f:
+    f.write(data)
+
+def write_archive(path, members):
+  # Write a BSD/GNU-compatible ar file without a symbol table. The
+  # linker reads all members anyway, and writing the file ourselves
+  # keeps Mach-O archives independent of the host binutils.
+  buf = bytearray(b'!<arch>\n')
+  for name, data in members:
+    name = (name + '/')[:16]
+    hdr = '%-16s%-12d%-6d%-6d%-8o%-10d`\n' % (name, 0, 0, 0, 0o644, len(data))
+    buf += hdr.encode()
+    buf += data
+    if len(data) % 2:
+      buf += b'\n'
+  write_file(path, bytes(buf))
+
+def words(rng, n):
+  alphabet = 'abcdefghijklmnopqrstuvwxyz'
+  return ' '.join(''.join(rng.choice(alphabet) for _ in range(rng.randint(3, 9)))
+                  for _ in range(n))
+
+def compile_all(jobs, cmds):
+  def run(cmd):
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+  with concurrent.futures.ThreadPoolExecutor(jobs) as pool:
+    for f in [pool.submit(run, c) for c in cmds]:
+      f.result()
+
+#
+# ELF generators
+#
+
+class ElfGenerator:
+  def __init__(self, args, dir):
+    self.args = args
+    self.dir = dir
+    self.cc = os.environ.get('CC', 'cc')
+    self.cxx = os.environ.get('CXX', 'c++')
+
+  def path(self, name):
+    return os.path.join(self.dir, name)
+
+  def compile(self, sources, flags, cxx=False):
+    cmds = []
+    objs = []
+    for name, src in sources:
+      ext = '.cc' if cxx else '.c'
+      write_file(self.path(name + ext), src)
+      objs.append(self.path(name + '.o'))
+      cmds.append([self.cxx if cxx else self.cc, '-c', '-O1', *flags,
+                   '-o', objs[-1], self.path(name + ext)])
+    compile_all(self.args.jobs, cmds)
+    return objs
+
+  def main_source(self, callees):
+    decls = ''.join('int %s(int);\n' % f for f in callees)
+    calls = ''.join('  r += %s(argc);\n' % f for f in callees)
+    return decls + 'int main(int argc, char **argv) {\n  int r = 0;\n' + \
+      calls + '  return r;\n}\n'
+
+  def functions(self, nobj, nfunc):
+    srcs = []
+    for i in range(nobj):
+      nxt = (i + 1) % nobj
+      src = 'int f%d_0(int);\n' % nxt
+      for j in range(nfunc):
+        callee = 'f%d_%d' % (i, j + 1) if j + 1 < nfunc else 'f%d_0' % nxt
+        if j + 1 < nfunc:
+          src += 'int %s(int);\n' % callee
+        src += 'int data%d_%d = %d;\n' % (i, j, j)
+        src += ('int f%d_%d(int x) { return x < 0 ? %s(x + 1) : '
+                'x + data%d_%d; }\n') % (i, j, callee, i, j)
+      srcs.append(('f%d' % i, src))
+    srcs.append(('main', self.main_source(['f0_0'])))
+    return self.compile(srcs, ['-ffunction-sections', '-fdata-sections'])
+
+  def strings(self, nobj, nstr):
+    rng = random.Random(1)
+    shared = [words(rng, 6) for _ in range(nstr)]
+    srcs = []
+    for i in range(nobj):
+      src = 'const char *s%d[] = {\n' % i
+      for j in range(nstr):
+        # Two thirds of the strings are duplicated across all files
+        s = shared[j] if j % 3 else '%d %s' % (i, words(rng, 6))
+        src += '  "%s",\n' % s
+      src += '};\nint f%d(int x) { return s%d[x][0]; }\n' % (i, i)
+      srcs.append(('s%d' % i, src))
+    srcs.append(('main', self.main_source(['f%d' % i for i in range(nobj)])))
+    return self.compile(srcs, [])
+
+  def comdat(self, nobj, nfunc):
+    common = ''.join(
+      'inline __attribute__((noinline)) int c%d(int x) { return x * %d; }\n' %
+      (j, j) for j in range(nfunc))
+    srcs = []
+    for i in range(nobj):
+      src = common + 'int f%d(int x) {\n  int r = 0;\n' % i
+      src += ''.join('  r += c%d(x);\n' % j for j in range(nfunc))
+      src += '  return r;\n}\n'
+      srcs.append(('c%d' % i, src))
+    srcs.append(('main', 'extern "C" {\n' +
+                 self.main_source([]) + '}\n'))
+    return self.compile(srcs, ['-ffunction-sections'], cxx=True)
+
+  def archive(self, nobj, nfunc):
+    srcs = []
+    for i in range(nobj):
+      src = ''.join('int a%d_%d(int x) { return x + %d; }\n' % (i, j, j)
+                    for j in range(nfunc))
+      srcs.append(('a%d' % i, src))
+    objs = self.compile(srcs, ['-ffunction-sections'])
+    members = [(os.path.basename(o), open(o, 'rb').read()) for o in objs]
+    write_archive(self.path('libbench.a'), members)
+    main = self.compile(
+      [('main', self.main_source(['a%d_0' % i for i in range(0, nobj, 2)]))], [])
+    return main + [self.path('libbench.a')]
+
+  def dylibs(self, nlib, nfunc):
+    srcs = []
+    for i in range(nlib):
+      src = ''.join('int d%d_%d(int x) { return x + %d; }\n' % (i, j, j)
+                    for j in range(nfunc))
+      srcs.append(('d%d' % i, src))
+    objs = self.compile(srcs, ['-fPIC'])
+    cmds = [[self.cc, '-shared', '-o', self.path('libd%d.so' % i), o]
+            for i, o in enumerate(objs)]
+    compile_all(self.args.jobs, cmds)
+    main = self.compile(
+      [('main', self.main_source(['d%d_0' % i for i in range(nlib)]))], [])
+    return main + ['-L' + self.dir, '-Wl,-rpath=' + self.dir] + \
+      ['-ld%d' % i for i in range(nlib)]
+
+  def debug(self, nobj, ntype):
+    srcs = []
+    for i in range(nobj):
+      src = ''
+      for j in range(ntype):
+        src += 'struct t%d { int a; long b; char c[%d]; struct t%d *p; };\n' % \
+          (j, j + 1, j)
+        src += 'int g%d_%d(struct t%d *p) { return p->a + p->c[0]; }\n' % (i, j, j)
+      srcs.append(('g%d' % i, src))
+    srcs.append(('main', self.main_source([])))
+    return self.compile(srcs, ['-g', '-ffunction-sections'])
+
+  def link_command(self, inputs, output):
+    return [self.cxx, '-B' + self.args.bindir, '-o', output, *inputs,
+            '-Wl,--perf=json']
+
+#
+# Mach-O generators
+#
+
+CPU_TYPE_ARM64 = 0x0100000c
+MH_OBJECT = 1
+MH_SUBSECTIONS_VIA_SYMBOLS = 0x2000
+LC_SEGMENT_64 = 0x19
+LC_SYMTAB = 0x2
+LC_DYSYMTAB = 0xb
+LC_BUILD_VERSION = 0x32
+
+S_CSTRING_LITERALS = 0x2
+S_ATTR_PURE_INSTRUCTIONS = 0x80000000
+S_ATTR_SOME_INSTRUCTIONS = 0x400
+S_ATTR_DEBUG = 0x02000000
+
+N_EXT = 0x1
+N_SECT = 0xe
+N_WEAK_DEF = 0x80
+
+ARM64_RELOC_BRANCH26 = 2
+ARM64_RELOC_PAGE21 = 3
+ARM64_RELOC_PAGEOFF12 = 4
+
+class MachObject:
+  # A minimal writer for ARM64 Mach-O relocatable object files. Each
+  # function consists of three instructions; the first two load the
+  # address of a string and the last one tail-calls another function.
+  def __init__(self):
+    self.text = bytearray()
+    self.cstring = bytearray()
+    self.debug = []
+    self.text_relocs = []
+    self.local_syms = []    # (name, sect_name, offset)
+    self.defined = []       # (name, offset, weak)
+    self.undefs = []
+    self.sym_index = {}
+
+  def add_string(self, s):
+    name = 'l_.str.%d' % len(self.local_syms)
+    self.local_syms.append((name, '__cstring', len(self.cstring)))
+    self.cstring += s.encode() + b'\0'
+    return name
+
+  def add_function(self, name, callee, string=None, weak=False):
+    off = len(self.text)
+    self.defined.append((name, off, weak))
+    if string is None:
+      self.text += struct.pack('<I', 0xd65f03c0)                # ret
+      self.text += struct.pack('<I', 0xd503201f) * 2            # nop
+    else:
+      self.text += struct.pack('<III', 0x90000000, 0x91000000, 0x14000000)
+      self.text_relocs.append((off, string, ARM64_RELOC_PAGE21, 1))
+      self.text_relocs.append((off + 4, string, ARM64_RELOC_PAGEOFF12, 0))
+      self.text_relocs.append((off + 8, callee, ARM64_RELOC_BRANCH26, 1))
+
+  def add_debug(self, sectname, data):
+    self.debug.append((sectname, data))
+
+  def serialize(self):
+    defined_names = {n for n, _, _ in self.defined}
+    undefs = sorted({r[1] for r in self.text_relocs
+                     if r[1] not in defined_names and not r[1].startswith('l_.')})
+
+    sects = [('__text', '__TEXT', bytes(self.text), 2,
+              S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS)]
+    if self.cstring:
+      sects.append(('__cstring', '__TEXT', bytes(self.cstring), 0,
+                    S_CSTRING_LITERALS))
+    for name, data in self.debug:
+      sects.append((name, '__DWARF', data, 0, S_ATTR_DEBUG))
+    sect_idx = {s[0]: i + 1 for i, s in enumerate(sects)}
+
+    ncmds = 4
+    sizeofcmds = (72 + 80 * len(sects)) + 24 + 24 + 80
+    off = 32 + sizeofcmds
+
+    # Section contents
+    addr = 0
+    sect_addr = {}
+    layout = []
+    for name, seg, data, align, flags in sects:
+      addr = (addr + (1 << align) - 1) & ~((1 << align) - 1)
+      off = (off + (1 << align) - 1) & ~((1 << align) - 1)
+      sect_addr[name] = addr
+      layout.append((addr, off))
+      addr += len(data)
+      off += len(data)
+    vmsize = addr
+
+    # Symbols are sorted as locals, external definitions and undefs
+    syms = []
+    for name, sect, o in self.local_syms:
+      syms.append((name, N_SECT, sect_idx[sect], 0, sect_addr[sect] + o))
+    for name, o, weak in sorted(self.defined):
+      syms.append((name, N_SECT | N_EXT, 1, N_WEAK_DEF if weak else 0,
+                   sect_addr['__text'] + o))
+    for name in undefs:
+      syms.append((name, N_EXT, 0, 0, 0))
+    index = {s[0]: i for i, s in enumerate(syms)}
+
+    relocs = bytearray()
+    for r_addr, sym, ty, pcrel in sorted(self.text_relocs, reverse=True):
+      info = index[sym] | (pcrel << 24) | (2 << 25) | (1 << 27) | (ty << 28)
+      relocs += struct.pack('<iI', r_addr, info)
+
+    off = (off + 7) & ~7
+    reloff = off
+    off += len(relocs)
+    symoff = off
+    off += 16 * len(syms)
+
+    strtab = bytearray(b'\0')
+    nlist = bytearray()
+    for name, ty, sect, desc, value in syms:
+      nlist += struct.pack('<IBBHQ', len(strtab), ty, sect, desc, value)
+      strtab += name.encode() + b'\0'
+    stroff = off
+
+    buf = bytearray()
+    buf += struct.pack('<IIIIIIII', 0xfeedfacf, CPU_TYPE_ARM64, 0, MH_OBJECT,
+                       ncmds, sizeofcmds, MH_SUBSECTIONS_VIA_SYMBOLS, 0)
+
+    filesize = layout[-1][1] + len(sects[-1][2]) - layout[0][1]
+    buf += struct.pack('<II16sQQQQiiII', LC_SEGMENT_64, 72 + 80 * len(sects),
+                       b'', 0, vmsize, layout[0][1], filesize, 7, 7,
+                       len(sects), 0)
+    for i, (name, seg, data, align, flags) in enumerate(sects):
+      nreloc = len(self.text_relocs) if i == 0 else 0
+      buf += struct.pack('<16s16sQQIIIIIIII', name.encode(), seg.encode(),
+                         layout[i][0], len(data), layout[i][1], align,
+                         reloff if nreloc else 0, nreloc, flags, 0, 0, 0)
+
+    buf += struct.pack('<IIIIII', LC_BUILD_VERSION, 24, 1, 0xb0000,
+                       0xb0000, 0)
+    buf += struct.pack('<IIIIII', LC_SYMTAB, 24, symoff, len(syms), stroff,
+                       len(strtab))
+
+    nlocal = len(self.local_syms)
+    ndef = len(self.defined)
+    buf += struct.pack('<20I', LC_DYSYMTAB, 80, 0, nlocal, nlocal, ndef,
+                       nlocal + ndef, len(undefs), *([0] * 12))
+
+    for i, (name, seg, data, align, flags) in enumerate(sects):
+      buf += b'\0' * (layout[i][1] - len(buf))
+      buf += data
+
+    buf += b'\0' * (reloff - len(buf))
+    buf += relocs + nlist + strtab
+    return bytes(buf)
+
+def write_tbd(path, install_name, symbols):
+  syms = ', '.join(symbols)
+  write_file(path, f"""--- !tapi-tbd
+tbd-version:     4
+targets:         [ arm64-macos ]
+install-name:    '{install_name}'
+current-version: 1
+exports:
+  - targets:     [ arm64-macos ]
+    symbols:     [ {syms} ]
+...
+""")
+
+class MachOGenerator:
+  def __init__(self, args, dir):
+    self.args = args
+    self.dir = dir
+    write_tbd(self.path('libSystem.tbd'), '/usr/lib/libSystem.B.dylib',
+              ['dyld_stub_binder'])
+
+  def path(self, name):
+    return os.path.join(self.dir, name)
+
+  def write_objects(self, objs):
+    paths = []
+    for name, obj in objs:
+      paths.append(self.path(name + '.o'))
+      write_file(paths[-1], obj.serialize())
+    return paths
+
+  def main_object(self, callees):
+    obj = MachObject()
+    s = obj.add_string('main')
+    obj.add_function('_main', callees[0] if callees else '_main', s)
+    # Reference the rest of the callees from separate functions
+    for i, callee in enumerate(callees[1:]):
+      obj.add_function('_main_%d' % i, callee, s)
+    return obj
+
+  def functions(self, nobj, nfunc):
+    objs = []
+    for i in range(nobj):
+      obj = MachObject()
+      nxt = (i + 1) % nobj
+      s = obj.add_string('f%d' % i)
+      for j in range(nfunc):
+        callee = '_f%d_%d' % (i, j + 1) if j + 1 < nfunc else '_f%d_0' % nxt
+        obj.add_function('_f%d_%d' % (i, j), callee, s)
+      objs.append(('f%d' % i, obj))
+    objs.append(('main', self.main_object(['_f0_0'])))
+    return self.write_objects(objs)
+
+  def strings(self, nobj, nstr):
+    rng = random.Random(1)
+    shared = [words(rng, 6) for _ in range(nstr)]
+    objs = []
+    for i in range(nobj):
+      obj = MachObject()
+      strs = [obj.add_string(shared[j] if j % 3 else '%d %s' % (i, words(rng, 6)))
+              for j in range(nstr)]
+      for j, s in enumerate(strs):
+        obj.add_function('_s%d_%d' % (i, j), '_s%d_0' % i, s)
+      objs.append(('s%d' % i, obj))
+    objs.append(('main', self.main_object(['_s%d_0' % i for i in range(nobj)])))
+    return self.write_objects(objs)
+
+  def comdat(self, nobj, nfunc):
+    objs = []
+    for i in range(nobj):
+      obj = MachObject()
+      s = obj.add_string('c')
+      for j in range(nfunc):
+        obj.add_function('_c%d' % j, '_c%d' % ((j + 1) % nfunc), s, weak=True)
+      obj.add_function('_f%d' % i, '_c0', s)
+      objs.append(('c%d' % i, obj))
+    objs.append(('main', self.main_object(['_f%d' % i for i in range(nobj)])))
+    return self.write_objects(objs)
+
+  def archive(self, nobj, nfunc):
+    members = []
+    for i in range(nobj):
+      obj = MachObject()
+      for j in range(nfunc):
+        obj.add_function('_a%d_%d' % (i, j), None)
+      members.append(('a%d.o' % i, obj.serialize()))
+    write_archive(self.path('libbench.a'), members)
+    main = self.write_objects(
+      [('main', self.main_object(['_a%d_0' % i for i in range(0, nobj, 2)]))])
+    return main + [self.path('libbench.a')]
+
+  def dylibs(self, nlib, nfunc):
+    libs = []
+    for i in range(nlib):
+      libs.append(self.path('libd%d.tbd' % i))
+      write_tbd(libs[-1], '/usr/lib/libd%d.dylib' % i,
+                ['_d%d_%d' % (i, j) for j in range(nfunc)])
+    main = self.write_objects(
+      [('main', self.main_object(['_d%d_0' % i for i in range(nlib)]))])
+    return main + libs
+
+  def debug(self, nobj, ntype):
+    rng = random.Random(2)
+    objs = []
+    for i in range(nobj):
+      obj = MachObject()
+      s = obj.add_string('g%d' % i)
+      for j in range(ntype):
+        obj.add_function('_g%d_%d' % (i, j), '_g%d_0' % i, s)
+      # The linker doesn't interpret the contents of debug sections
+      # other than noticing that they exist, so random bytes will do.
+      obj.add_debug('__debug_info', rng.randbytes(ntype * 64))
+      obj.add_debug('__debug_str', ''.join(
+        't%d_%d\0' % (i, j) for j in range(ntype)).encode())
+      objs.append(('g%d' % i, obj))
+    objs.append(('main', self.main_object(['_g0_0'])))
+    return self.write_objects(objs)
+
+  def link_command(self, inputs, output):
+    return [os.path.join(self.args.bindir, 'ld64'), '-arch', 'arm64',
+            '-platform_version', 'macos', '11.0', '11.0', '-o', output, *inputs,
+            self.path('libSystem.tbd'), '--perf=json']
+
+#
+# Scenarios
+#
+
+# (name, base N, base M). N and M are multiplied by --scale.
+SCENARIOS = [
+  ('functions', 256, 128),
+  ('strings',   128, 512),
+  ('comdat',    128, 128),
+  ('archive',   512, 32),
+  ('dylibs',    64,  256),
+  ('debug',     128, 128),
+]
+
+GENERATORS = {'elf': ElfGenerator, 'macho': MachOGenerator}
+
+def generate(args, format, name, n, m):
+  # Inputs are cached in a directory whose name depends on the generator
+  # parameters, so that repeated runs don't pay the generation cost.
+  key = '%s-%s-%d-%d-%d' % (format, name, n, m, GENERATOR_VERSION)
+  dir = os.path.join(args.workdir, key)
+  stamp = os.path.join(dir, 'inputs.json')
+
+  if os.path.exists(stamp):
+    with open(stamp) as f:
+      return dir, json.load(f)
+
+  shutil.rmtree(dir, ignore_errors=True)
+  os.makedirs(dir)
+  gen = GENERATORS[format](args, dir)
+  inputs = getattr(gen, name)(n, m)
+  write_file(stamp, json.dumps(inputs))
+  return dir, inputs
+
+def run_link(args, format, dir, inputs):
+  gen = GENERATORS[format](args, dir)
+  cmd = gen.link_command(inputs, os.path.join(dir, 'out'))
+  proc = subprocess.run(cmd, check=True, stdout=subprocess.PIPE)
+
+  # The compiler driver may print something before the linker does
+  text = proc.stdout.decode()
+  records = json.loads(text[text.index('['):])
+  all = next(r for r in records if r['name'] == 'all')
+  passes = {c['name']: c['real'] for c in all['children']}
+  return {'real': all['real'], 'user': all['user'], 'sys': all['sys'],
+          'peak_rss': all['peak_rss'], 'passes': passes}
+
+def mad(xs):
+  m = statistics.median(xs)
+  return statistics.median(abs(x - m) for x in xs)
+
+def summarize(samples):
+  real = [s['real'] for s in samples]
+  passes = {}
+  for name in samples[0]['passes']:
+    passes[name] = statistics.median(s['passes'].get(name, 0) for s in samples)
+  return {
+    'samples': real,
+    'median': statistics.median(real),
+    'mad': mad(real),
+    'user': statistics.median(s['user'] for s in samples),
+    'peak_rss': statistics.median(s['peak_rss'] for s in samples),
+    'passes': passes,
+  }
+
+def compare(args, cur, base):
+  # 1.4826 * MAD is a robust estimate of the standard deviation. A
+  # difference is significant if it exceeds three of those of the two
+  # runs combined, as well as the relative threshold.
+  noise = 3 * 1.4826 * (cur['mad'] ** 2 + base['mad'] ** 2) ** 0.5
+  diff = cur['median'] - base['median']
+  limit = max(noise, base['median'] * args.threshold / 100)
+  if diff > limit:
+    return 'SLOWER'
+  if -diff > limit:
+    return 'faster'
+  return '~'
+
+def main():
+  parser = argparse.ArgumentParser(description='Run mold benchmarks')
+  parser.add_argument('--mold', default='./mold')
+  parser.add_argument('--workdir', default='out/bench')
+  parser.add_argument('--format', choices=['elf', 'macho', 'all'], default='all')
+  parser.add_argument('--filter', default='')
+  parser.add_argument('--scale', type=float, default=1.0)
+  parser.add_argument('--runs', type=int, default=5)
+  parser.add_argument('--warmup', type=int, default=1)
+  parser.add_argument('--jobs', type=int, default=os.cpu_count())
+  parser.add_argument('--threshold', type=float, default=3.0,
+                      help='minimum slowdown in percent to report')
+  parser.add_argument('--baseline')
+  parser.add_argument('--save-baseline', action='store_true')
+  parser.add_argument('--json', help='write results to this file')
+  args = parser.parse_args()
+
+  args.mold = os.path.abspath(args.mold)
+  if not args.baseline:
+    args.baseline = os.path.join(args.workdir, 'baseline.json')
+  os.makedirs(args.workdir, exist_ok=True)
+
+  # The linker chooses the ELF or the Mach-O flavor by argv[0]. The
+  # ELF flavor is invoked via the compiler driver's -B option.
+  args.bindir = os.path.abspath(os.path.join(args.workdir, 'bin'))
+  os.makedirs(args.bindir, exist_ok=True)
+  for name in ['ld', 'ld64']:
+    path = os.path.join(args.bindir, name)
+    if os.path.lexists(path):
+      os.remove(path)
+    os.symlink(args.mold, path)
+
+  formats = ['elf', 'macho'] if args.format == 'all' else [args.format]
+  baseline = {}
+  if os.path.exists(args.baseline):
+    with open(args.baseline) as f:
+      baseline = json.load(f)
+
+  results = {}
+  regressed = False
+
+  print('%-18s %10s %8s %10s %10s  %s' %
+        ('Benchmark', 'Median', 'MAD', 'Baseline', 'Peak RSS', 'Result'))
+
+  for format in formats:
+    for name, n, m in SCENARIOS:
+      key = format + '/' + name
+      if not re.search(args.filter, key):
+        continue
+
+      n = max(1, round(n * args.scale))
+      m = max(1, round(m * args.scale))
+      dir, inputs = generate(args, format, name, n, m)
+
+      for _ in range(args.warmup):
+        run_link(args, format, dir, inputs)
+      cur = summarize([run_link(args, format, dir, inputs)
+                       for _ in range(args.runs)])
+      cur['params'] = [n, m]
+      results[key] = cur
+
+      base = baseline.get(key)
+      if base and base.get('params') == cur['params']:
+        status = compare(args, cur, base)
+        regressed |= (status == 'SLOWER')
+        base_str = '%.3fs' % base['median']
+      else:
+        status = 'no baseline'
+        base_str = '-'
+
+      print('%-18s %9.3fs %7.3fs %10s %8.1fMB  %s' %
+            (key, cur['median'], cur['mad'], base_str,
+             cur['peak_rss'] / 1024 / 1024, status), flush=True)
+
+  if args.json:
+    write_file(args.json, json.dumps(results, indent=2))
+
+  if args.save_baseline or not baseline:
+    baseline.update(results)
+    write_file(args.baseline, json.dumps(baseline, indent=2))
+    print('baseline saved to ' + args.baseline)
+
+  return 1 if regressed else 0
+
+if __name__ == '__main__':
+  sys.exit(main())
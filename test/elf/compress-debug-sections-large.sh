@@ -0,0 +1,56 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+# Create debug sections larger than the piece size used for
+# streamed compression.
+for i in 1 2 3 4; do
+  for j in $(seq 3000); do
+    echo "struct s${i}_$j { int a$j; long b$j; char c$j[$j]; };"
+    echo "int f${i}_$j(struct s${i}_$j *p) { return p->a$j + p->c$j[0]; }"
+  done | $CC -c -g -o $t/a$i.o -xc -
+done
+
+cat <<EOF | $CC -c -g -o $t/b.o -xc -
+#include <stdio.h>
+
+int main() {
+  printf("Hello world\n");
+  return 0;
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a*.o $t/b.o
+$CC -B. -o $t/exe2 $t/a*.o $t/b.o -Wl,--compress-debug-sections=zlib
+$QEMU $t/exe2 | grep -q 'Hello world'
+
+readelf -WS $t/exe2 | grep -E '\.debug_info .* [A-Z]*C[A-Z]* ' > /dev/null
+
+for sec in .debug_info .debug_str .debug_abbrev; do
+  readelf -z -x $sec $t/exe1 > $t/log1
+  readelf -z -x $sec $t/exe2 > $t/log2
+  diff -q $t/log1 $t/log2
+done
+
+# A merged string section whose hash map shards are larger than the
+# piece size, so each shard is split at fragment boundaries.
+seq 40000 | awk '{ printf ".string \"%0500d\"\n", $1 }' |
+  sed '1i .section .debug_str,"MS",@progbits,1' |
+  $CC -c -o $t/c.o -xassembler -
+
+$CC -B. -o $t/exe4 $t/c.o $t/b.o
+$CC -B. -o $t/exe5 $t/c.o $t/b.o -Wl,--compress-debug-sections=zlib
+$QEMU $t/exe5 | grep -q 'Hello world'
+
+readelf -z -p .debug_str $t/exe4 > $t/log4
+readelf -z -p .debug_str $t/exe5 > $t/log5
+diff -q $t/log4 $t/log5
+
+# zstd-compressed sections consist of multiple frames and a seek table
+$CC -B. -o $t/exe3 $t/a*.o $t/b.o -Wl,--compress-debug-sections=zstd
+$QEMU $t/exe3 | grep -q 'Hello world'
+
+readelf -z -x .debug_info $t/exe3 > $t/log3 2>&1 || skip
+grep -q 'unsupported\|failed' $t/log3 && skip
+readelf -z -x .debug_info $t/exe1 > $t/log1
+diff -q $t/log1 $t/log3
+
@@ -0,0 +1,34 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = x86_64 ] || skip
+
+# A single input section larger than the piece size used for streamed
+# compression is split into multiple pieces.
+cat <<EOF | $CC -c -o $t/a.o -xassembler -
+.globl main
+.text
+main:
+  xor %eax, %eax
+  ret
+
+.section .debug_foo,"",@progbits
+.rept 100000
+.quad main
+.long 0x01020304
+.fill 20,1,7
+.endr
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o
+$CC -B. -o $t/exe2 $t/a.o -Wl,--compress-debug-sections=zlib
+$CC -B. -o $t/exe3 $t/a.o -Wl,--compress-debug-sections=zstd
+$QEMU $t/exe2
+
+readelf -x .debug_foo $t/exe1 > $t/log1
+readelf -z -x .debug_foo $t/exe2 > $t/log2
+diff -q $t/log1 $t/log2
+
+readelf -z -x .debug_foo $t/exe3 > $t/log3 2>&1 || skip
+grep -q 'unsupported\|failed' $t/log3 && skip
+diff -q $t/log1 $t/log3
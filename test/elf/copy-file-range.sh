@@ -0,0 +1,34 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+# A large non-alloc section is copied to the output file with
+# copy_file_range(2) if possible. Relocations are applied on top of it.
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+
+__asm__(".section .debug_foo\n"
+        ".fill 100000, 1, 7\n"
+        ".dc.a main\n"
+        ".fill 100000, 1, 9\n"
+        ".previous\n");
+EOF
+
+rm -f $t/b.a
+ar rcs $t/b.a $t/a.o
+
+$CC -B. -o $t/exe1 $t/a.o
+$QEMU $t/exe1 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe2 $t/a.o -Wl,--:no-copy-file-range
+cmp $t/exe1 $t/exe2
+
+# The same section in an archive member
+$CC -B. -o $t/exe3 -Wl,--whole-archive $t/b.a -Wl,--no-whole-archive
+$QEMU $t/exe3 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe4 -Wl,--whole-archive $t/b.a -Wl,--no-whole-archive \
+  -Wl,--:no-copy-file-range
+cmp $t/exe3 $t/exe4
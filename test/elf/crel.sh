@@ -0,0 +1,44 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -ffunction-sections -fdata-sections -fPIC -
+#include <stdio.h>
+
+int x = 3;
+int *p = &x;
+const char *str = "world";
+
+void hello(const char *s) {
+  printf("Hello %s %d\n", s, *p);
+}
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -xc -ffunction-sections -fdata-sections -fPIC -
+void hello(const char *s);
+extern const char *str;
+
+int main() {
+  hello(str);
+}
+EOF
+
+./mold -r -o $t/c.o $t/a.o $t/b.o -z crel
+readelf -WS $t/c.o > $t/log
+grep -Fq .crel.text $t/log
+! grep -Fq .rela.text $t/log || false
+! grep -Eq '\.rel\.text' $t/log || false
+
+./mold -r -o $t/d.o $t/a.o $t/b.o
+[ $(stat -c %s $t/c.o) -lt $(stat -c %s $t/d.o) ]
+
+# Read CREL sections created above as input
+$CC -B. -o $t/exe1 $t/c.o
+$QEMU $t/exe1 | grep -q 'Hello world 3'
+
+./mold -r -o $t/e.o $t/c.o
+$CC -B. -o $t/exe2 $t/e.o
+$QEMU $t/exe2 | grep -q 'Hello world 3'
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--emit-relocs -Wl,-z,crel
+$QEMU $t/exe3 | grep -q 'Hello world 3'
+readelf -WS $t/exe3 | grep -Fq .crel.text
@@ -0,0 +1,41 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = ppc64 ] && skip
+
+cat <<EOF | $CC -c -o $t/a.o -ffunction-sections -fdata-sections -xc -
+#include <stdio.h>
+
+int bar() {
+  return 5;
+}
+
+int foo1(int x) {
+  return bar() + x;
+}
+
+int foo2(int x) {
+  return bar() + x;
+}
+
+int foo3() {
+  bar();
+  return 5;
+}
+
+int main() {
+  printf("%d %d\n", (long)foo1 == (long)foo2, (long)foo1 == (long)foo3);
+  return 0;
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o -Wl,-icf=all -Wl,-icf-hash=xxh3
+$QEMU $t/exe1 | grep -q '1 0'
+
+$CC -B. -o $t/exe2 $t/a.o -Wl,-icf=all -Wl,-icf-hash=sha256
+$QEMU $t/exe2 | grep -q '1 0'
+
+cmp $t/exe1 $t/exe2
+
+{ ./mold --icf-hash=foo || true; } 2>&1 | \
+  grep -q 'unknown --icf-hash argument: foo'
@@ -0,0 +1,34 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+# Emulate GNU make 4.4's jobserver with two job slots available
+rm -f $t/fifo
+mkfifo $t/fifo
+exec 3<>$t/fifo
+printf '+-' >&3
+
+MAKEFLAGS="-j3 --jobserver-auth=fifo:$t/fifo" $CC -B. -o $t/exe $t/a.o
+$QEMU $t/exe | grep -q 'Hello world'
+
+# All tokens must have been returned as they were
+read -t 5 -N 2 tokens <&3
+[ ${#tokens} = 2 ]
+[[ $tokens == *+* ]]
+[[ $tokens == *-* ]]
+
+# Stale file descriptors are ignored
+MAKEFLAGS="-j3 --jobserver-auth=100,101" $CC -B. -o $t/exe $t/a.o
+$QEMU $t/exe | grep -q 'Hello world'
+
+MAKEFLAGS="-j3 --jobserver-auth=fifo:$t/fifo" \
+  $CC -B. -o $t/exe $t/a.o -Wl,--no-jobserver
+$QEMU $t/exe | grep -q 'Hello world'
+
+exec 3>&-
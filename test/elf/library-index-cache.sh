@@ -0,0 +1,33 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+mkdir -p $t/lib1 $t/lib2
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int foo();
+int main() { printf("%d\n", foo()); }
+EOF
+
+echo 'int foo() { return 1; }' | $CC -o $t/b.o -c -xc -
+echo 'int foo() { return 2; }' | $CC -o $t/c.o -c -xc -
+rm -f $t/lib1/libfoo.a $t/lib2/libfoo.a
+ar rcs $t/lib2/libfoo.a $t/b.o
+
+$CC -B. -o $t/exe1 $t/a.o -L$t/lib1 -L$t/lib2 -lfoo \
+  -Wl,--library-index-cache=$t/cache
+$QEMU $t/exe1 | grep -q '^1$'
+
+# Directories modified in the last few seconds are not cached
+touch -d '2020-01-01' $t/lib1 $t/lib2
+$CC -B. -o $t/exe2 $t/a.o -L$t/lib1 -L$t/lib2 -lfoo \
+  -Wl,--library-index-cache=$t/cache
+$QEMU $t/exe2 | grep -q '^1$'
+grep -q "$t/lib2\$" $t/cache
+grep -q '^libfoo.a$' $t/cache
+
+# Adding a file updates the directory's mtime and invalidates the cache
+ar rcs $t/lib1/libfoo.a $t/c.o
+$CC -B. -o $t/exe3 $t/a.o -L$t/lib1 -L$t/lib2 -lfoo \
+  -Wl,--library-index-cache=$t/cache
+$QEMU $t/exe3 | grep -q '^2$'
@@ -0,0 +1,41 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+echo 'int main() {}' | $GCC -flto -o /dev/null -xc - >& /dev/null \
+  || skip
+
+cat <<EOF | $GCC -o $t/a.o -c -flto -xc -
+#include <stdio.h>
+void hello() {
+  printf("Hello world\n");
+}
+EOF
+
+cat <<EOF | $GCC -o $t/b.o -c -flto -xc -
+#include <stdio.h>
+void howdy() {
+  printf("Hello world\n");
+}
+EOF
+
+rm -f $t/c.a
+ar rc $t/c.a $t/a.o $t/b.o
+
+cat <<EOF | $GCC -o $t/d.o -c -flto -xc -
+void hello();
+int main() {
+  hello();
+}
+EOF
+
+# --:lto-api-v0 makes mold behave as if the plugin didn't support the
+# v3 API. Archive members are then passed to the plugin only after
+# symbol resolution. claim_live_files shows up in the --perf output
+# only if mold didn't have to restart itself.
+$GCC -B. -o $t/exe -flto $t/d.o $t/c.a -Wl,--:lto-api-v0,--perf > $t/log
+$QEMU $t/exe | grep -q 'Hello world'
+grep -q claim_live_files $t/log
+
+nm $t/exe > $t/log
+grep -q hello $t/log
+! grep -q howdy $t/log || false
@@ -0,0 +1,34 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+# Each object file has a 3 MiB .data section with pointers that need
+# relocation, so the output .data is split into multiple pieces and
+# written in multiple waves if the memory budget is small.
+for i in 1 2 3; do
+  cat <<EOF | $CC -o $t/a$i.o -c -xc -
+int foo$i() { return $i; }
+char buf$i[3 << 20] = {$i};
+void *ptr$i[] = { foo$i, buf$i, buf$i + 1000000, buf$i + 2000000 };
+EOF
+done
+
+cat <<EOF | $CC -o $t/b.o -c -xc -
+#include <stdio.h>
+extern char buf1[], buf2[], buf3[];
+extern void *ptr1[], *ptr2[], *ptr3[];
+int main() {
+  printf("%d %d %d %d\n", buf1[0], buf2[0], buf3[0],
+         ptr3[1] == buf3 && ptr2[3] == buf2 + 2000000);
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a1.o $t/a2.o $t/a3.o $t/b.o
+$QEMU $t/exe1 | grep -q '^1 2 3 1$'
+
+$CC -B. -o $t/exe2 $t/a1.o $t/a2.o $t/a3.o $t/b.o \
+  -Wl,--memory-limit=1,--stats > $t/log
+$QEMU $t/exe2 | grep -q '^1 2 3 1$'
+cmp $t/exe1 $t/exe2
+
+waves=$(sed -n 's/^ *memory_limit_waves=//p' $t/log)
+[ "$waves" -gt 4 ]
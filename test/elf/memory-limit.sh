@@ -0,0 +1,28 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -g -xc -
+#include <stdio.h>
+extern const char *msg;
+int main() {
+  printf("%s\n", msg);
+}
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -g -xc -
+const char *msg = "Hello world";
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o
+$QEMU $t/exe1 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--memory-limit=1
+$QEMU $t/exe2 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe2
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--memory-limit=16G \
+  -Wl,--compress-debug-sections=zlib
+$QEMU $t/exe3 | grep -q 'Hello world'
+
+! $CC -B. -o $t/exe4 $t/a.o $t/b.o -Wl,--memory-limit=foo 2> $t/log || false
+grep -q 'invalid --memory-limit argument: foo' $t/log
@@ -0,0 +1,42 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+# Pages are released with MADV_PAGEOUT, which needs Linux 5.4 or later.
+cat <<EOF | $CC -o $t/pageout -xc - >& /dev/null || skip
+#include <sys/mman.h>
+int main() {
+  char *p = mmap(0, 4096, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  p[0] = 1;
+  return madvise(p, 4096, MADV_PAGEOUT) != 0;
+}
+EOF
+$QEMU $t/pageout || skip
+
+# With --no-keep-memory, pages of input sections are released once they
+# are written, so the peak RSS is smaller than that of a regular link.
+# We use a single thread so that only one input section is resident at
+# a time.
+for i in 1 2 3 4 5 6 7 8; do
+  echo "char buf$i[4 << 20] = {$i};" | $CC -o $t/a$i.o -c -xc -
+done
+
+cat <<EOF | $CC -o $t/b.o -c -xc -
+#include <stdio.h>
+extern char buf1[], buf8[];
+int main() {
+  printf("%d %d\n", buf1[0], buf8[0]);
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a?.o $t/b.o -Wl,--threads=1,--stats > $t/log1
+$QEMU $t/exe1 | grep -q '^1 8$'
+
+$CC -B. -o $t/exe2 $t/a?.o $t/b.o -Wl,--threads=1,--stats,--no-keep-memory \
+  > $t/log2
+$QEMU $t/exe2 | grep -q '^1 8$'
+cmp $t/exe1 $t/exe2
+
+rss1=$(sed -n 's/^ *peak_rss_bytes=//p' $t/log1)
+rss2=$(sed -n 's/^ *peak_rss_bytes=//p' $t/log2)
+[ $((rss1 - rss2)) -gt $((16 << 20)) ]
@@ -0,0 +1,29 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -g -xc -
+#include <stdio.h>
+extern const char *msg;
+int main() {
+  printf("%s\n", msg);
+}
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -g -xc -
+const char *msg = "Hello world";
+EOF
+
+rm -f $t/c.a
+ar rcs $t/c.a $t/b.o
+
+$CC -B. -o $t/exe1 $t/a.o $t/c.a
+$QEMU $t/exe1 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe2 $t/a.o $t/c.a -Wl,--no-keep-memory
+$QEMU $t/exe2 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe2
+
+$CC -B. -o $t/exe3 $t/a.o $t/c.a -Wl,--no-keep-memory \
+  -Wl,--compress-debug-sections=zlib -Wl,--Map=$t/map
+$QEMU $t/exe3 | grep -q 'Hello world'
+grep -q main $t/map
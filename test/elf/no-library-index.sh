@@ -0,0 +1,21 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+mkdir -p $t/lib1 $t/lib2
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int foo();
+int main() { printf("%d\n", foo()); }
+EOF
+
+echo 'int foo() { return 1; }' | $CC -o $t/b.o -c -xc -
+rm -f $t/lib2/libfoo.a
+ar rcs $t/lib2/libfoo.a $t/b.o
+
+$CC -B. -o $t/exe1 $t/a.o -L$t/lib1 -L$t/lib2 -lfoo -Wl,--no-library-index
+$QEMU $t/exe1 | grep -q '^1$'
+
+! $CC -B. -o $t/exe2 $t/a.o -L$t/lib1 -lfoo -Wl,--no-library-index \
+  2> $t/log || false
+grep -q 'library not found: foo' $t/log
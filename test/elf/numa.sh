@@ -0,0 +1,21 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+extern const char *msg;
+int main() {
+  printf("%s\n", msg);
+}
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -xc -
+const char *msg = "Hello world";
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o
+$QEMU $t/exe1 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--numa
+$QEMU $t/exe2 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe2
@@ -0,0 +1,56 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = m68k ] && skip
+[ $MACHINE = ppc ] && skip
+
+command -v llvm-readelf >& /dev/null || skip
+
+# The packed table is smaller than the regular one, so the following
+# sections are moved. We compare relocations without their addresses.
+get_relocs() {
+  llvm-readelf -r $1 | grep -E '^[0-9a-f]+ ' | awk '{print $3, $5, $6, $7}' | sort
+}
+
+cat <<EOF | $CC -o $t/a.o -fPIC -c -xc -
+extern int foo, bar;
+int x[10];
+int y;
+
+int *p[] = {
+  &x[0], &x[1], &x[2], &x[3], &x[4], &x[5], &x[6], &x[7], &x[8], &x[9],
+  &y, &x[3], &y, &x[1],
+  &foo, &foo, &foo + 1, &foo + 2,
+  &bar, &bar, &bar, &bar, &bar + 5,
+};
+EOF
+
+$CC -B. -o $t/b.so -shared $t/a.o
+get_relocs $t/b.so > $t/log1
+
+$CC -B. -o $t/c.so -shared $t/a.o -Wl,-pack-dyn-relocs=android
+get_relocs $t/c.so > $t/log2
+
+diff $t/log1 $t/log2
+
+llvm-readelf --dynamic $t/c.so > $t/log3
+grep -Eq 'ANDROID_RELA?SZ' $t/log3
+! grep -Eq '\((RELA?ENT|RELA?SZ)\)' $t/log3 || false
+
+llvm-readelf -S $t/c.so | grep -Eq 'ANDROID_RELA?'
+
+# The space for the unpacked table is not reserved in the output
+{
+  echo 'int z[1000];'
+  echo 'int *q[] = {'
+  for i in $(seq 0 999); do echo "&z[$i],"; done
+  echo '};'
+} | $CC -o $t/d.o -fPIC -c -xc -
+
+$CC -B. -o $t/e.so -shared $t/d.o
+$CC -B. -o $t/f.so -shared $t/d.o -Wl,-pack-dyn-relocs=android
+[ $(stat -c %s $t/f.so) -lt $(( $(stat -c %s $t/e.so) - 4000 )) ]
+
+get_relocs $t/e.so > $t/log4
+get_relocs $t/f.so > $t/log5
+diff $t/log4 $t/log5
@@ -0,0 +1,31 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+# Hardware counters may not be available in a VM or a container.
+# The link must succeed either way.
+$CC -B. -o $t/exe $t/a.o -Wl,--perf-counters,--perf > $t/log 2> $t/err
+$QEMU $t/exe | grep -q 'Hello world'
+grep -q copy_chunks $t/log
+
+if grep -q 'performance counters are not available' $t/err; then
+  ! grep -q Cycles $t/log || false
+else
+  grep -q 'Cycles.*IPC' $t/log
+fi
+
+$CC -B. -o $t/exe $t/a.o -Wl,--perf-counters,--perf=json > $t/log 2> $t/err
+$QEMU $t/exe | grep -q 'Hello world'
+grep -q '"name": "copy_chunks"' $t/log
+
+if grep -q 'performance counters are not available' $t/err; then
+  ! grep -q '"cycles":' $t/log || false
+else
+  grep -q '"cycles":' $t/log
+fi
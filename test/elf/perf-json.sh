@@ -0,0 +1,29 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+command -v python3 >& /dev/null || skip
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+$CC -B. -o $t/exe $t/a.o -Wl,--perf=json > $t/log
+$QEMU $t/exe | grep -q 'Hello world'
+python3 -c 'import json, sys; json.load(open(sys.argv[1]))' $t/log
+grep -q '"name": "copy_chunks"' $t/log
+grep -q '"peak_rss": ' $t/log
+
+$CC -B. -o $t/exe $t/a.o -Wl,--perf=trace:$t/trace.json
+python3 -c 'import json, sys; json.load(open(sys.argv[1]))["traceEvents"]' \
+  $t/trace.json
+grep -q '"ph": "X"' $t/trace.json
+
+# Timestamps are printed in microseconds with nanosecond precision
+grep -Eq '"ts": [0-9]+\.[0-9]{3}, "dur": [0-9]+\.[0-9]{3},' $t/trace.json
+! grep -Eq '"(ts|dur)": [0-9.]+e' $t/trace.json || false
+
+! $CC -B. -o $t/exe $t/a.o -Wl,--perf=foo 2> $t/log || false
+grep -q 'unknown --perf argument: foo' $t/log
@@ -0,0 +1,21 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int foo();
+int main() { printf("%d\n", foo()); }
+EOF
+
+echo 'int foo() { return 42; }' | $CC -o $t/b.o -c -xc -
+echo 'int bar() { return 1; }' | $CC -o $t/c.o -c -xc -
+rm -f $t/libfoo.a
+ar rcs $t/libfoo.a $t/c.o $t/b.o
+
+$CC -B. -o $t/exe1 $t/a.o -L$t -lfoo -Wl,--prefetch
+$QEMU $t/exe1 | grep -q '^42$'
+
+! $CC -B. -o $t/exe2 $t/a.o $t/libfoo.a $t/nonexistent.so -Wl,--prefetch \
+  2> /dev/null || false
+$CC -B. -o $t/exe2 $t/a.o $t/libfoo.a -Wl,--no-prefetch
+$QEMU $t/exe2 | grep -q '^42$'
@@ -0,0 +1,27 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+$CC -B. -o $t/exe $t/a.o -Wl,--stats > $t/log
+$QEMU $t/exe | grep -q 'Hello world'
+
+grep -Eq 'peak_rss_bytes=[1-9]' $t/log
+grep -Eq 'mem_arena=[1-9]' $t/log
+grep -q 'mem_object_files=' $t/log
+grep -q 'peak_rss_pass=' $t/log
+
+# Uncompressed debug sections are counted in mem_string_pool
+$CC -o $t/b.o -c -g -gz=zlib -xc /dev/null >& /dev/null || skip
+echo 'int foo() { return 0; }' | $CC -o $t/b.o -c -g -xc -
+echo 'int foo() { return 0; }' | $CC -o $t/c.o -c -g -gz=zlib -xc -
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--stats > $t/log1
+$CC -B. -o $t/exe $t/a.o $t/c.o -Wl,--stats > $t/log2
+size1=$(sed -n 's/^ *mem_string_pool=//p' $t/log1)
+size2=$(sed -n 's/^ *mem_string_pool=//p' $t/log2)
+[ $size1 -lt $size2 ]
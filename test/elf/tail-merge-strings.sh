@@ -0,0 +1,30 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc - -O2
+const char *foo1 = "foobar";
+const char *foo2 = "xyzzy";
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -xc - -O2
+#include <stdio.h>
+
+extern const char *foo1;
+extern const char *foo2;
+const char *bar1 = "bar";
+const char *bar2 = "zy";
+
+int main() {
+  printf("%s %s %s %s %d %d\n", foo1, foo2, bar1, bar2,
+         (int)(bar1 - foo1), (int)(bar2 - foo2));
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o -no-pie
+$QEMU $t/exe1 | grep -q '^foobar xyzzy bar zy '
+
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -no-pie -Wl,-O2
+$QEMU $t/exe2 | grep -q '^foobar xyzzy bar zy 3 3$'
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -no-pie -Wl,--O2
+$QEMU $t/exe3 | grep -q '^foobar xyzzy bar zy 3 3$'